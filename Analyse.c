@@ -1,11 +1,57 @@
 
 
 #include "Analyse.h"
+#include "CGen.h"
 #include "Globals.h"
+#include "Intern.h"
 #include "SymTab.h"
+#include "Thread.h"
 #include "Util.h"
 
 
+/* The fewest source lines worth giving a thread of their own to analyse */
+#define MINRUNLINES 2000
+
+
+/*
+ * What the analyser knows about where it has got to in the program.  The
+ *  function fields start afresh as each function declaration is entered.
+ */
+
+typedef struct
+{
+    TreeNode *function;     /* the enclosing function, or NULL            */
+    int      bodyEntered;   /* has its body's compound-statement started? */
+    int      localSize;     /* space its parameters and locals take up    */
+    int      localOffset;   /* LP offset of the last one laid out         */
+    int      globalOffset;  /* GP offset of the next global variable      */
+
+    /*
+     * TRUE if the top-level declarations, and the parameters of the
+     *  functions, were typed ahead of the walk (and mustn't be touched,
+     *  since other threads may be looking at them).
+     */
+    int      topLevelTyped;
+} AnalyserState;
+
+
+/*
+ * When analysing in parallel, the top-level declarations are cut up into
+ *  runs, and each run is walked on a thread of its own, just as the serial
+ *  walk would have, but into a listing file of its own.
+ */
+
+typedef struct
+{
+    TreeNode *first;          /* the first top-level declaration in it     */
+    int      count;           /* how many it has                           */
+    int      *globalsBefore;  /* globals declared before each of them      */
+    int      globalOffset;    /* GP offset of its first global variable    */
+    FILE     *listing;        /* what analysing it had to say              */
+    int      error;           /* did that include any errors?              */
+} AnalyserRun;
+
+
 /*********************************************************************
  *  Module-static function declarations
  */
@@ -13,26 +59,39 @@
 /* draw a ruler on the screen */
 static void drawRuler(FILE *output, char *string);
 
-/* the guts of buildSymbolTable() */
-static void buildSymbolTable2(TreeNode *syntaxTree);
+/* the guts of analyseProgram(): the one walk over the tree */
+static void analyseTree(TreeNode *syntaxTree);
+
+/* analyseProgram() on "numRuns" threads, if it can be */
+static int analyseInParallel(TreeNode *syntaxTree, int numRuns);
+
+/* analyses one of the runs that analyseInParallel() cuts the tree into */
+static void analyseRun(void *item);
+
+/* walks "count" top-level declarations, or all of them if it's -1 */
+static void analyseDeclarations(TreeNode *first, int count,
+                                AnalyserState *state, int *globalsBefore);
+
+/* makes a state for starting a walk at the top level */
+static void startState(AnalyserState *state, int globalOffset,
+                       int topLevelTyped);
+
+/* what to do on entering a node: scopes, and binding names */
+static void enterNode(TreeNode *syntaxTree, AnalyserState *state);
+
+/* what to do on leaving a node: scopes, and frame layout */
+static void leaveNode(TreeNode *syntaxTree, AnalyserState *state, int depth);
+
+/* work out the size and offset of a variable or parameter */
+static void layoutVariable(TreeNode *syntaxTree, AnalyserState *state,
+                           int isGlobal);
 
 /* flag an error from the type checker */
 static void flagSemanticError(char *str);
 
-/* generic tree traversal routine */
-static void traverse(TreeNode *syntaxTree,
-                     void (*preProc)(TreeNode *),
-                     void (*postProc)(TreeNode *) );
-
 /* routine to perform the actual type check on a node */
 static void checkNode(TreeNode *syntaxTree);
 
-/* dummy do-nothing procedure used to keep traversal() happy */
-static void nullProc(TreeNode *syntaxTree);
-
-/* traverse the syntax tree, marking global variables as such */
-void markGlobals(TreeNode *tree);
-
 /* declare the C-minus "built-in" input() and output() routines */
 static void declarePredefines(void);
 
@@ -44,8 +103,10 @@ static int checkFormalAgainstActualParms(TreeNode *formal, TreeNode *actual);
  *  Public function definitions
  */
 
-void buildSymbolTable(TreeNode *syntaxTree)
+void analyseProgram(TreeNode *syntaxTree)
 {
+    int numRuns;
+
     /* Format headings */
     if (TraceAnalyse)
     {
@@ -56,11 +117,16 @@ void buildSymbolTable(TreeNode *syntaxTree)
                 "depth                   Decl.  parm?\n");
     }
 
+    initSymbolTable();
     declarePredefines();   /* make input() and output() visible in globals */
-    buildSymbolTable2(syntaxTree);
 
-    /* set the isGlobal field in appropriate nodes: needed in code generator */
-    markGlobals(syntaxTree);
+    /* each thread is worth at least MINRUNLINES lines of source */
+    numRuns = lineno / MINRUNLINES;
+    if (numRuns > AnalyseThreads)
+        numRuns = AnalyseThreads;
+
+    if ((numRuns < 2) || !analyseInParallel(syntaxTree, numRuns))
+        analyseTree(syntaxTree);
 
     /* Dump the global scope, if it's asked for */
     if (TraceAnalyse)
@@ -73,12 +139,6 @@ void buildSymbolTable(TreeNode *syntaxTree)
 }
 
 
-void typeCheck(TreeNode *syntaxTree)
-{
-    traverse(syntaxTree, nullProc, checkNode);
-}
-
-
 /*********************************************************************
  *  Static function declarations
  */
@@ -92,164 +152,410 @@ static void declarePredefines(void)
 
     /* define "int input(void)" */
     input = newDecNode(FuncDecK);
-    input->name = copyString("input");
-    input->functionReturnType = Integer;
+    input->name = internName("input");
+    DECINFO(input)->functionReturnType = Integer;
     input->expressionType = Function;
 
     /* define "void output(int)" */
     temp = newDecNode(ScalarDecK);
-    temp->name = copyString("arg");
-    temp->variableDataType = Integer;
+    temp->name = internName("arg");
+    DECINFO(temp)->variableDataType = Integer;
     temp->expressionType = Integer;
 
     output = newDecNode(FuncDecK);
-    output->name = copyString("output");
-    output->functionReturnType = Void;
+    output->name = internName("output");
+    DECINFO(output)->functionReturnType = Void;
     output->expressionType = Function;
-    output->child[0] = temp;
+    output->child[0] = nodeIndex(temp);
 
     /* get input() and output() added to global scope */
-    insertSymbol("input", input, 0);
-    insertSymbol("output", output, 0);
+    insertSymbol(input->name, input, 0);
+    insertSymbol(output->name, output, 0);
 }
 
 
-static void buildSymbolTable2(TreeNode *syntaxTree)
+/*
+ * Names are bound, and declarations typed, on the way down; everything
+ *  else is type checked on the way back up, once its children have been.
+ *  A declaration's type is known as soon as it's entered, so a function's
+ *  own body sees it.
+ */
+
+static void analyseTree(TreeNode *syntaxTree)
 {
-    int         i;         /* iterate over node children */
-    HashNodePtr luSymbol;  /* symbol being looked up */
-    char        errorMessage[80];
+    AnalyserState state;
+
+    startState(&state, 0, FALSE);
+    analyseDeclarations(syntaxTree, -1, &state, NULL);
+}
+
+
+/*
+ * The globals have to be declared, in order, before the runs can start:
+ *  a run has to see just those declared before each of its own top-level
+ *  declarations, and shareGlobals() gives it them.  They're typed, along
+ *  with the functions' parameters, since any run may refer to them.
+ *
+ * Each run's listing file is copied out in order afterwards, so the
+ *  listing comes out just as it would from a single thread.  Returns FALSE,
+ *  having done nothing, if there aren't the files to do that with.
+ */
 
-    /* used to decorate RETURN nodes with enclosing procedure */
-    static TreeNode *enclosingFunction = NULL;
-    static int firstCompoundAfterFun = 1;
-    while (syntaxTree != NULL)
+static int analyseInParallel(TreeNode *syntaxTree, int numRuns)
+{
+    AnalyserRun *runs;
+    int         *globalsBefore;
+    int         numDeclarations = 0;
+    int         globalOffset = 0;
+    int         cut;     /* line at which the next run starts */
+    int         i, c;
+    TreeNode    *node;
+    TreeNode    *param;
+    char        buffer[BUFSIZ];
+
+    for (node = syntaxTree; node != NULL; node = NODE(node->sibling))
+        ++numDeclarations;
+
+    runs = (AnalyserRun*)calloc(numRuns, sizeof(*runs));
+    globalsBefore = (int*)malloc(numDeclarations * sizeof(int));
+    if ((runs == NULL) || (globalsBefore == NULL))
+    {
+        fprintf(listing, "*** Out of memory analysing the program.\n");
+        exit(1);
+    }
+
+    for (i = 0; i < numRuns; ++i)
     {
-        /*
-         * Examine current symbol: if it's a declaration, insert into
-         *  symbol table.
-         */
-        if (syntaxTree->nodekind == DecK)
-            insertSymbol(syntaxTree->name, syntaxTree, syntaxTree->lineno);
-
-        /* If entering a new function, tell the symbol table */
-        if ((syntaxTree->nodekind == DecK)
-                && (syntaxTree->kind.dec == FuncDecK))
+        runs[i].listing = tmpfile();
+        if (runs[i].listing == NULL)
         {
-            /* record the enclosing procedure declaration */
-            enclosingFunction = syntaxTree;
-
-            if (TraceAnalyse)
-                /*
-                 *  For functions at least, it's nice to tell the user
-                 *   whereabouts in the program the variable comes into
-                 *   scope.  We don't bother printing out compound-stmt
-                 *   scopes
-                */
-                drawRuler(listing, syntaxTree->name);
+            while (i-- > 0)
+                fclose(runs[i].listing);
 
-            newScope();
-            ++scopeDepth;
-            firstCompoundAfterFun=0;
+            free(runs);
+            free(globalsBefore);
+            return FALSE;
         }
+    }
+
+    /* declare the globals, cutting runs at evenly spaced lines as we go */
+    i = -1;
+    cut = 0;
 
-        /* If entering a compound-statement, create a new scope as well */
-        if ((syntaxTree->nodekind == StmtK)
-                && (syntaxTree->kind.stmt == CompoundK))
+    for (node = syntaxTree, c = 0; node != NULL; node = NODE(node->sibling), ++c)
+    {
+        if ((node->lineno >= cut) && (i < numRuns - 1))
         {
-			if (firstCompoundAfterFun==0)
-			{
-				firstCompoundAfterFun=1;
-			} 
-			else
-			{
-				newScope();
-				++scopeDepth;
-			}
-			
-
-           
-            
+            ++i;
+            cut = (int)((double)lineno * (i + 1) / numRuns);
+
+            runs[i].first = node;
+            runs[i].globalsBefore = &globalsBefore[c];
+            runs[i].globalOffset = globalOffset;
         }
 
-        /*
-         *  If the current node is an identifier, it needs to be checked
-         *   against the symbol table, and annotated with a pointer back to
-         *   it's declaration.
-         */
+        ++runs[i].count;
 
-        if (((syntaxTree->nodekind == ExpK)  /* identifier reference... */
-                && (syntaxTree->kind.exp == IdK))
-                || ((syntaxTree->nodekind == StmtK)  /* function call... */
-                    && (syntaxTree->kind.stmt == CallK)))
-        {
-            DEBUG_ONLY(
-                fprintf(listing,
-                        "*** Annotating identifier \"%s\" on line %d\n",
-                        syntaxTree->name, syntaxTree->lineno); );
+        globalsBefore[c] = countSymbols();
+        declareGlobal(node->name, node, node->lineno);
+        checkNode(node);
 
-            luSymbol = lookupSymbol(syntaxTree->name);
-            if (luSymbol == NULL)
-            {
-                /* operation failed; say so to user */
-                sprintf(errorMessage,
-                        "identifier \"%s\" unknown or out of scope\n",
-                        syntaxTree->name);
-                flagSemanticError(errorMessage);
-            }
-            else
-            {
-                /*
-                 *  Annotate identifier tree-node with a pointer to it's
-                 *   declaration.
-                 */
-                syntaxTree->declaration = luSymbol->declaration;
-            }
+        if ((node->nodekind == DecK) && (node->kind.dec == FuncDecK))
+        {
+            for (param = NODE(node->child[0]); param != NULL;
+                    param = NODE(param->sibling))
+                checkNode(param);
         }
+        else
+            globalOffset += varSize(node);
+    }
+
+    runThreads(analyseRun, runs, i + 1, sizeof(*runs));
+
+    /* copy the runs' listings out in order */
+    for (i = 0; i < numRuns; ++i)
+    {
+        rewind(runs[i].listing);
+        while ((c = (int)fread(buffer, 1, sizeof(buffer), runs[i].listing)) > 0)
+            fwrite(buffer, 1, c, listing);
+
+        fclose(runs[i].listing);
+
+        if (runs[i].error)
+            Error = TRUE;
+    }
+
+    free(runs);
+    free(globalsBefore);
+    return TRUE;
+}
 
-        /*
-         *  If the current node is a RETURN statement, we need to mark
-         *   it with the enclosing procedure's declaration node.  This
-         *   information is used later by the type checker to check
-         *   function return types.
-         */
-        if ((syntaxTree->nodekind == StmtK) &&
-                (syntaxTree->kind.stmt == ReturnK))
+
+/*
+ * runThreads() might not be able to start a thread for the run, and do it
+ *  on the calling thread instead; so the listing and error flag are put
+ *  back afterwards.
+ */
+
+static void analyseRun(void *item)
+{
+    AnalyserRun   *run = (AnalyserRun*)item;
+    AnalyserState state;
+    FILE          *oldListing = listing;
+    int           oldError = Error;
+
+    listing = run->listing;
+    Error = FALSE;
+
+    startState(&state, run->globalOffset, TRUE);
+    analyseDeclarations(run->first, run->count, &state, run->globalsBefore);
+    releaseSymbolTable();
+
+    run->error = Error;
+
+    listing = oldListing;
+    Error = oldError;
+}
+
+
+/*
+ * Names are bound, and declarations typed, on the way down; everything
+ *  else is type checked on the way back up, once its children have been.
+ *  A declaration's type is known as soon as it's entered, so a function's
+ *  own body sees it.
+ *
+ * With "globalsBefore", the walk is one of several runs, each with its
+ *  own symbol table, which gets the globals each top-level declaration
+ *  should see before it's entered.
+ */
+
+static void analyseDeclarations(TreeNode *first, int count,
+                                AnalyserState *state, int *globalsBefore)
+{
+    TreeWalk walk;
+    int      step;
+    int      done = 0;   /* top-level declarations walked so far */
+
+    startWalk(&walk, first);
+
+    while ((done != count) && ((step = walkTree(&walk)) != WALKDONE))
+    {
+        if (step == WALKENTER)
         {
-            syntaxTree->declaration = enclosingFunction;
+            if ((walk.depth == 1) && (globalsBefore != NULL))
+                shareGlobals(globalsBefore[done]);
+
+            enterNode(walk.node, state);
 
-            DEBUG_ONLY( fprintf(listing,
-                                "*** Marking return statement on line %d with pointer to "
-                                "%s() declaration\n",
-                                syntaxTree->lineno,
-                                syntaxTree->declaration->name) );
+            /* depths 1 and 2 hold top-level declarations and parameters */
+            if ((walk.node->nodekind == DecK)
+                    && ((walk.depth > 2) || !state->topLevelTyped))
+                checkNode(walk.node);
         }
+        else
+        {
+            leaveNode(walk.node, state, walk.depth);
 
-        for (i=0; i < MAXCHILDREN; ++i)
-            if (syntaxTree->child[i]!=NULL)
-            {
-                buildSymbolTable2(syntaxTree->child[i]);
-            }
+            if (walk.node->nodekind != DecK)
+                checkNode(walk.node);
 
+            if (walk.depth == 1)
+                ++done;
+        }
+    }
+
+    endWalk(&walk);
+}
+
+
+static void startState(AnalyserState *state, int globalOffset,
+                       int topLevelTyped)
+{
+    state->function = NULL;
+    state->bodyEntered = TRUE;
+    state->localSize = state->localOffset = 0;
+    state->globalOffset = globalOffset;
+    state->topLevelTyped = topLevelTyped;
+}
+
+
+static void enterNode(TreeNode *syntaxTree, AnalyserState *state)
+{
+    HashNodePtr luSymbol;  /* symbol being looked up */
+    char        errorMessage[80];
 
-        /* If leaving a scope, tell the symbol table */
-        if ((syntaxTree->nodekind == StmtK)
-                && (syntaxTree->kind.stmt == CompoundK))
+    /*
+     * Examine current symbol: if it's a declaration, insert into
+     *  symbol table.
+     */
+    if (syntaxTree->nodekind == DecK)
+        insertSymbol(syntaxTree->name, syntaxTree, syntaxTree->lineno);
+
+    /* If entering a new function, tell the symbol table */
+    if ((syntaxTree->nodekind == DecK)
+            && (syntaxTree->kind.dec == FuncDecK))
+    {
+        /* record the enclosing procedure declaration */
+        state->function = syntaxTree;
+        state->bodyEntered = FALSE;
+
+        /* its parameters and locals go below the saved registers */
+        state->localSize = 0;
+        state->localOffset = -2;
+
+        if (TraceAnalyse)
+            /*
+             *  For functions at least, it's nice to tell the user
+             *   whereabouts in the program the variable comes into
+             *   scope.  We don't bother printing out compound-stmt
+             *   scopes
+            */
+            drawRuler(listing, syntaxTree->name);
+
+        newScope();
+        ++scopeDepth;
+    }
+
+    /*
+     * If entering a compound-statement, create a new scope as well; but
+     *  a function's body shares the scope of its parameters.
+     */
+    if ((syntaxTree->nodekind == StmtK)
+            && (syntaxTree->kind.stmt == CompoundK))
+    {
+        if (!state->bodyEntered)
+            state->bodyEntered = TRUE;
+        else
         {
-            if (TraceAnalyse)
-                dumpCurrentScope();
-            --scopeDepth;
-            endScope();
+            newScope();
+            ++scopeDepth;
         }
+    }
 
-        /* do post-order operations here */
+    /*
+     *  If the current node is an identifier, it needs to be checked
+     *   against the symbol table, and annotated with a pointer back to
+     *   it's declaration.
+     */
 
-        /* visit next sibling */
-        syntaxTree = syntaxTree->sibling;
+    if (((syntaxTree->nodekind == ExpK)  /* identifier reference... */
+            && (syntaxTree->kind.exp == IdK))
+            || ((syntaxTree->nodekind == StmtK)  /* function call... */
+                && (syntaxTree->kind.stmt == CallK)))
+    {
+        DEBUG_ONLY(
+            fprintf(listing,
+                    "*** Annotating identifier \"%s\" on line %d\n",
+                    syntaxTree->name, syntaxTree->lineno); );
+
+        luSymbol = lookupSymbol(syntaxTree->name);
+        if (luSymbol == NULL)
+        {
+            /* operation failed; say so to user */
+            sprintf(errorMessage,
+                    "identifier \"%s\" unknown or out of scope\n",
+                    syntaxTree->name);
+            flagSemanticError(errorMessage);
+        }
+        else
+        {
+            /*
+             *  Annotate identifier tree-node with a pointer to it's
+             *   declaration.
+             */
+            syntaxTree->declaration = nodeIndex(luSymbol->declaration);
+        }
+    }
+
+    /*
+     *  If the current node is a RETURN statement, we need to mark
+     *   it with the enclosing procedure's declaration node.  This
+     *   information is used by the type checker to check function
+     *   return types.
+     */
+    if ((syntaxTree->nodekind == StmtK) &&
+            (syntaxTree->kind.stmt == ReturnK))
+    {
+        syntaxTree->declaration = nodeIndex(state->function);
+
+        DEBUG_ONLY( fprintf(listing,
+                            "*** Marking return statement on line %d with pointer to "
+                            "%s() declaration\n",
+                            syntaxTree->lineno,
+                            NODE(syntaxTree->declaration)->name) );
+    }
+}
+
+
+/* Only variables at the top of the tree are globals */
+static void leaveNode(TreeNode *syntaxTree, AnalyserState *state, int depth)
+{
+    /* If leaving a scope, tell the symbol table */
+    if ((syntaxTree->nodekind == StmtK)
+            && (syntaxTree->kind.stmt == CompoundK))
+    {
+        if (TraceAnalyse)
+            dumpCurrentScope();
+        --scopeDepth;
+        endScope();
+    }
+
+    if ((syntaxTree->nodekind == DecK)
+            && ((syntaxTree->kind.dec == ScalarDecK)
+                || (syntaxTree->kind.dec == ArrayDecK)))
+        layoutVariable(syntaxTree, state, depth == 1);
+
+    /* leaving a function? record its frame size, saved registers and all */
+    if ((syntaxTree->nodekind == DecK)
+            && (syntaxTree->kind.dec == FuncDecK))
+    {
+        DECINFO(syntaxTree)->localSize = state->localSize + 3;
+
+        DEBUG_ONLY( fprintf(listing,
+                            "*** Calculated localSize attribute for %s() as %d.\n",
+                            syntaxTree->name, DECINFO(syntaxTree)->localSize); );
     }
 }
 
 
+/*
+ * Globals are laid out upwards from GP.  A function's parameters and
+ *  locals are laid out downwards from its LP, and "localSize" records how
+ *  much of its frame they've taken up so far.
+ */
+
+static void layoutVariable(TreeNode *syntaxTree, AnalyserState *state,
+                           int isGlobal)
+{
+    DecInfo *decInfo = DECINFO(syntaxTree);
+    int     size = varSize(syntaxTree);
+
+    if (isGlobal)
+    {
+        DEBUG_ONLY( fprintf(listing,
+                            "*** Marked %s as a global variable\n",
+                            syntaxTree->name); );
+
+        decInfo->isGlobal = TRUE;
+        decInfo->localSize = size;
+        decInfo->offset = state->globalOffset;
+        state->globalOffset += size;
+    }
+    else
+    {
+        state->localSize += size;
+        state->localOffset -= size;
+
+        decInfo->localSize = state->localSize;
+        decInfo->offset = state->localOffset;
+    }
+
+    DEBUG_ONLY( fprintf(listing,
+                        "*** computed offset attribute for %s as %d\n",
+                        syntaxTree->name, decInfo->offset); );
+}
+
+
 static void drawRuler(FILE *output, char *string)
 {
     int length;
@@ -279,27 +585,6 @@ static void flagSemanticError(char *str)
 }
 
 
-/* generic tree traversal routine */
-static void traverse(TreeNode *syntaxTree,
-                     void (*preProc)(TreeNode *),
-                     void (*postProc)(TreeNode *) )
-{
-    int i;
-
-    while (syntaxTree != NULL)
-    {
-        preProc(syntaxTree);
-
-        for (i=0; i < MAXCHILDREN; ++i)
-            traverse(syntaxTree->child[i], preProc, postProc);
-
-        postProc(syntaxTree);
-
-        syntaxTree = syntaxTree->sibling;
-    }
-}
-
-
 /*
  * Take a pair of tree nodes whose children contain definitions of formal
  *  parameters, and expressions-as-actual-parameters respectively.
@@ -313,16 +598,16 @@ static int checkFormalAgainstActualParms(TreeNode *formal, TreeNode *actual)
     TreeNode *firstList;
     TreeNode *secondList;
 
-    firstList = formal->child[0];
-    secondList = actual->child[0];
+    firstList = NODE(formal->child[0]);
+    secondList = NODE(actual->child[0]);
 
     while ((firstList != NULL) && (secondList != NULL))
     {
         if (firstList->expressionType != secondList->expressionType)
             return FALSE;
 
-        if (firstList) firstList = firstList->sibling;
-        if (secondList) secondList = secondList->sibling;
+        if (firstList) firstList = NODE(firstList->sibling);
+        if (secondList) secondList = NODE(secondList->sibling);
     }
 
     if (((firstList == NULL) && (secondList != NULL))
@@ -345,7 +630,7 @@ static void checkNode(TreeNode *syntaxTree)
         switch (syntaxTree->kind.dec)
         {
         case ScalarDecK:
-            syntaxTree->expressionType = syntaxTree->variableDataType;
+            syntaxTree->expressionType = DECINFO(syntaxTree)->variableDataType;
             break;
 
         case ArrayDecK:
@@ -365,7 +650,7 @@ static void checkNode(TreeNode *syntaxTree)
         {
         case IfK:
 
-            if (syntaxTree->child[0]->expressionType != Integer)
+            if (NODE(syntaxTree->child[0])->expressionType != Integer)
             {
                 sprintf(errorMessage,
                         "IF-expression must be integer (line %d)\n",
@@ -377,7 +662,7 @@ static void checkNode(TreeNode *syntaxTree)
 
         case WhileK:
 
-            if (syntaxTree->child[0]->expressionType != Integer)
+            if (NODE(syntaxTree->child[0])->expressionType != Integer)
             {
                 sprintf(errorMessage,
                         "WHILE-expression must be integer (line %d)\n",
@@ -389,8 +674,15 @@ static void checkNode(TreeNode *syntaxTree)
 
         case CallK:
 
+            /* unknown functions have been complained about already */
+            if (syntaxTree->declaration == 0)
+            {
+                syntaxTree->expressionType = Integer;
+                break;
+            }
+
             /*  Check types and numbers of formal against actual parameters */
-            if (!checkFormalAgainstActualParms(syntaxTree->declaration,
+            if (!checkFormalAgainstActualParms(NODE(syntaxTree->declaration),
                                                syntaxTree))
             {
                 sprintf(errorMessage, "formal and actual parameters to "
@@ -404,7 +696,7 @@ static void checkNode(TreeNode *syntaxTree)
              *   of the return type of the procedure being called
              */
             syntaxTree->expressionType
-                = syntaxTree->declaration->functionReturnType;
+                = DECINFO(NODE(syntaxTree->declaration))->functionReturnType;
 
             break;
 
@@ -415,10 +707,10 @@ static void checkNode(TreeNode *syntaxTree)
              *   must have the type of the return type of the function.
              */
 
-            if (syntaxTree->declaration->functionReturnType == Integer)
+            if (DECINFO(NODE(syntaxTree->declaration))->functionReturnType == Integer)
             {
-                if ((syntaxTree->child[0] == NULL)
-                        || (syntaxTree->child[0]->expressionType != Integer))
+                if ((syntaxTree->child[0] == 0)
+                        || (NODE(syntaxTree->child[0])->expressionType != Integer))
                 {
                     sprintf(errorMessage, "RETURN-expression is either "
                             "missing or not integer (line %d)\n",
@@ -426,10 +718,10 @@ static void checkNode(TreeNode *syntaxTree)
                     flagSemanticError(errorMessage);
                 }
             }
-            else if (syntaxTree->declaration->functionReturnType == Void)
+            else if (DECINFO(NODE(syntaxTree->declaration))->functionReturnType == Void)
             {
                 /* does a return-expression exist? complain */
-                if (syntaxTree->child[0] != NULL)
+                if (syntaxTree->child[0] != 0)
                 {
                     sprintf(errorMessage, "RETURN-expression must be"
                             "void (line %d)\n", syntaxTree->lineno);
@@ -466,8 +758,8 @@ static void checkNode(TreeNode *syntaxTree)
             if ((syntaxTree->op == PLUS) || (syntaxTree->op == MINUS) ||
                     (syntaxTree->op == TIMES) || (syntaxTree->op == DIVIDE))
             {
-                if ((syntaxTree->child[0]->expressionType == Integer) &&
-                        (syntaxTree->child[1]->expressionType == Integer))
+                if ((NODE(syntaxTree->child[0])->expressionType == Integer) &&
+                        (NODE(syntaxTree->child[1])->expressionType == Integer))
                     syntaxTree->expressionType = Integer;
                 else
                 {
@@ -481,8 +773,8 @@ static void checkNode(TreeNode *syntaxTree)
                      (syntaxTree->op == LTE) || (syntaxTree->op == GTE) ||
                      (syntaxTree->op == EQ) || (syntaxTree->op == NE))
             {
-                if ((syntaxTree->child[0]->expressionType == Integer) &&
-                        (syntaxTree->child[1]->expressionType == Integer))
+                if ((NODE(syntaxTree->child[0])->expressionType == Integer) &&
+                        (NODE(syntaxTree->child[1])->expressionType == Integer))
                     syntaxTree->expressionType = Integer;
                 else
                 {
@@ -503,12 +795,15 @@ static void checkNode(TreeNode *syntaxTree)
         case IdK:
             /*
              *  Handle identifiers. We can just have arrays, scalars, or
-             *   array element references.
+             *   array element references.  Unknown ones have been
+             *   complained about already, and pass as integers.
              */
 
-            if (syntaxTree->declaration->expressionType == Integer)
+            if (syntaxTree->declaration == 0)
+                syntaxTree->expressionType = Integer;
+            else if (NODE(syntaxTree->declaration)->expressionType == Integer)
             {
-                if (syntaxTree->child[0] == NULL)
+                if (syntaxTree->child[0] == 0)
                     syntaxTree->expressionType = Integer;
                 else
                 {
@@ -519,14 +814,14 @@ static void checkNode(TreeNode *syntaxTree)
                     flagSemanticError(errorMessage);
                 }
             }
-            else if (syntaxTree->declaration->expressionType == Array)
+            else if (NODE(syntaxTree->declaration)->expressionType == Array)
             {
-                if (syntaxTree->child[0] == NULL)
+                if (syntaxTree->child[0] == 0)
                     syntaxTree->expressionType = Array;
                 else
                 {
                     /* Identifier is indexed by an expression */
-                    if (syntaxTree->child[0]->expressionType == Integer)
+                    if (NODE(syntaxTree->child[0])->expressionType == Integer)
                         syntaxTree->expressionType = Integer;
                     else
                     {
@@ -555,8 +850,8 @@ static void checkNode(TreeNode *syntaxTree)
         case AssignK:
 
             /* Variable assignment */
-            if ((syntaxTree->child[0]->expressionType == Integer) &&
-                    (syntaxTree->child[1]->expressionType == Integer))
+            if ((NODE(syntaxTree->child[0])->expressionType == Integer) &&
+                    (NODE(syntaxTree->child[1])->expressionType == Integer))
                 syntaxTree->expressionType = Integer;
             else
             {
@@ -574,44 +869,5 @@ static void checkNode(TreeNode *syntaxTree)
 }
 
 
-void markGlobals(TreeNode *syntaxTree)
-{
-    TreeNode *cursor;
-
-    DEBUG_ONLY( char scratch[80]; );
-
-    cursor = syntaxTree;
-
-    while (cursor != NULL)
-    {
-        if ((cursor->nodekind==DecK)&&
-                ((cursor->kind.dec==ScalarDecK)||
-                 (cursor->kind.dec==ArrayDecK)))
-        {
-
-            DEBUG_ONLY(
-                sprintf(scratch, "*** Marked %s as a global variable\n",
-                        cursor->name);
-                fprintf(listing, scratch);
-            );
-
-            cursor->isGlobal = TRUE;
-        }
-
-        cursor = cursor->sibling;
-    }
-}
-
-
-/* dummy do-nothing procedure used to keep traverse() happy */
-static void nullProc(TreeNode *syntaxTree)
-{
-    if (syntaxTree == NULL)
-        return;
-    else
-        return;
-}
-
-
 /* END OF FILE */
 
@@ -7,21 +7,14 @@
 #include "Globals.h"
 
 /*
- * NAME:    buildSymboltable()
- * PURPOSE: Takes a syntax tree and traverses it, building a symbol table
- *           and decorating all identifiers with references to their
- *           declarations.
+ * NAME:    analyseProgram()
+ * PURPOSE: Takes a syntax tree and, in a single traversal of it, builds
+ *           a symbol table, decorates all identifiers with references to
+ *           their declarations, type checks the program, and lays out the
+ *           globals and each function's stack frame for the code generator.
  */
 
-void buildSymbolTable(TreeNode *syntaxTree);
-
-
-/*
- * NAME:    typeCheck()
- * PURPOSE: Traverses the syntax tree and type checks the program.
- */
-
-void typeCheck(TreeNode *syntaxTree);
+void analyseProgram(TreeNode *syntaxTree);
 
 #endif
 
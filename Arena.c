@@ -0,0 +1,107 @@
+
+
+#include "Globals.h"
+#include "Arena.h"
+
+
+/*
+ * The arena is a chain of blocks, each at least ARENABLOCKSIZE bytes.
+ *  Allocations are bumped off the newest block; when one won't fit, a new
+ *  block is started (made big enough for it) and the rest of the old one
+ *  is left unused.
+ */
+
+#define ARENABLOCKSIZE (64 * 1024)
+
+/* every allocation is rounded up to a multiple of this */
+#define ARENAALIGN     8
+
+#define ALIGNUP(n)     (((n) + (ARENAALIGN - 1)) & ~(size_t)(ARENAALIGN - 1))
+
+typedef struct arenaBlock
+{
+    struct arenaBlock *next;      /* block allocated before this one */
+    size_t            size;       /* bytes of space in this block    */
+} ArenaBlock;
+
+/* space in a block starts after its (aligned) header */
+#define BLOCKSPACE(block) ((char*)(block) + ALIGNUP(sizeof(ArenaBlock)))
+
+
+static ArenaBlock *blocks = NULL;     /* newest block first           */
+static char       *nextFree = NULL;   /* next free byte in the newest */
+static char       *blockEnd = NULL;   /* one past the end of newest   */
+
+/* Statistics reported by printArenaStatistics() */
+static size_t       bytesUsed = 0;
+static size_t       peakUsed = 0;
+static size_t       bytesReserved = 0;
+static unsigned int numBlocks = 0;
+
+
+void *arenaAlloc(size_t size)
+{
+    ArenaBlock *block;
+    size_t     blockSize;
+    void       *space;
+
+    size = ALIGNUP(size);
+
+    if ((nextFree == NULL) || ((size_t)(blockEnd - nextFree) < size))
+    {
+        blockSize = (size > ARENABLOCKSIZE) ? size : ARENABLOCKSIZE;
+
+        /* calloc() so that everything handed out is already zeroed */
+        block = (ArenaBlock*)calloc(1, ALIGNUP(sizeof(ArenaBlock)) + blockSize);
+        if (block == NULL)
+            return NULL;
+
+        block->next = blocks;
+        block->size = blockSize;
+        blocks = block;
+
+        nextFree = BLOCKSPACE(block);
+        blockEnd = nextFree + blockSize;
+
+        bytesReserved += blockSize;
+        ++numBlocks;
+    }
+
+    space = nextFree;
+    nextFree += size;
+
+    bytesUsed += size;
+    if (bytesUsed > peakUsed)
+        peakUsed = bytesUsed;
+
+    return space;
+}
+
+
+void releaseArena(void)
+{
+    ArenaBlock *block;
+
+    while (blocks != NULL)
+    {
+        block = blocks;
+        blocks = block->next;
+        free(block);
+    }
+
+    nextFree = blockEnd = NULL;
+    bytesUsed = bytesReserved = 0;
+    numBlocks = 0;
+}
+
+
+void printArenaStatistics(void)
+{
+    fprintf(listing, "*** Arena: %lu bytes in use, %lu peak, "
+                     "%lu reserved in %u blocks\n",
+            (unsigned long)bytesUsed, (unsigned long)peakUsed,
+            (unsigned long)bytesReserved, numBlocks);
+}
+
+
+/* END OF FILE */
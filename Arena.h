@@ -0,0 +1,43 @@
+
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * The compilation arena.  Syntax tree nodes, identifier names and labels
+ *  all live for the whole of a compilation, so rather than malloc() each
+ *  one, they're carved off large blocks with a bump pointer and all
+ *  released together by releaseArena() when the compilation is over.
+ */
+
+
+/*
+ * NAME:     arenaAlloc()
+ * PURPOSE:  Returns "size" bytes of zeroed memory from the arena, or NULL
+ *            if we've run out of memory.
+ */
+
+void *arenaAlloc(size_t size);
+
+
+/*
+ * NAME:     releaseArena()
+ * PURPOSE:  Releases everything allocated from the arena in one go.
+ */
+
+void releaseArena(void);
+
+
+/*
+ * NAME:     printArenaStatistics()
+ * PURPOSE:  Prints how much of the arena is in use, its peak usage and how
+ *            much memory it has reserved to the listing file.
+ */
+
+void printArenaStatistics(void);
+
+#endif
+
+/* END OF FILE */
@@ -6,30 +6,50 @@
 
 #include "CGen.h"
 #include "Globals.h"
+#include "Intern.h"
 #include "Util.h"
 #include "Code.h"
 
 static int tmpOffset=0;
 
-/*********************************************************************
- *  Module-static function declarations
+/*
+ * Registers ac up to MAXREG hold the temporaries of expressions; gp, mp
+ *  and pc are the only registers above them.
  */
+#define MAXREG 4
 
+/* what a call or an assignment needs: every register there is */
+#define ALLREGS (MAXREG + 1)
 
+/* where a return in an inlined call's body jumps to; -1 outside one */
+static int inlineExit = -1;
+
+/* the label just after the current function's prologue, if it has one */
+static int functionBody = -1;
 
 /*
- * Traverses the AST calculating the "size" attribute for each
- *  function found - the "size" is the size of the local variables allocated
- *  on the top of the stack.
+ * the register need of each expression node, by node index, with the
+ *  CLOBBERS bit set if there's a call or an assignment in it
  */
-void calcSizeAttribute(TreeNode *syntaxTree);
-
+static unsigned char *registerNeeds = NULL;
+static int registerNeedCapacity = 0;
 
 /*
- * Traverses the AST calculating AP/LP offsets for function parameters/
- *  function locals respectively.
+ * the operators of the left leaning chains being labelled or generated,
+ *  outermost first; each call works above the entries it found there
  */
-void calcStackOffsets(TreeNode *syntaxTree);
+static TreeNode **spine = NULL;
+static int spineCount = 0;
+static int spineCapacity = 0;
+
+#define CLOBBERS 0x80
+#define NEED(node) (registerNeeds[(node)->index] & ~CLOBBERS)
+#define CLOBBERING(node) (registerNeeds[(node)->index] & CLOBBERS)
+
+/*********************************************************************
+ *  Module-static function declarations
+ */
+
 
 
 /* emitComment(): emit a DCode comment to the output file. */
@@ -81,36 +101,47 @@ void genFunctionLocals2(TreeNode *tree);
 
 /*
  *  genStatement(): given a statement AST node, generates
- *   appropriate DCode. Delegates as necessary.
+ *   appropriate DCode, including that for IF and WHILE statements.
+ *   Delegates as necessary.
  */
 void genStatement();
 
 
 /*
- * Generate DCode for an Expression.
+ * Generate DCode for an Expression, leaving its value (or, if
+ *  addressNeeded, its address) in ac.
  */
 void genExpression(TreeNode *tree, int addressNeeded);
 
+/* Sethi-Ullman labelling, and generation into a given register */
+static int labelExpression(TreeNode *tree);
+static int setNeed(TreeNode *tree, int need, int clobbers);
+static void genValue(TreeNode *tree, int addressNeeded, int reg);
+static void genChain(TreeNode *tree, int reg);
+static void genClobbering(TreeNode *tree, int reg);
+static int leftFirst(TreeNode *tree);
+static void genOperands(TreeNode *tree, int reg, int *left, int *right);
+static void genSecondOperand(TreeNode *tree, TreeNode *first, int reg,
+                             int *left, int *right);
+static void genOperator(TreeNode *tree, int reg, int left, int right);
 
 /*
- * Generate and return a new unique label.
+ * Generate DCode for the condition of an IF or a WHILE, jumping to
+ *  falseLabel if it's false.
  */
-char *genNewLabel(void);
+void genCondition(TreeNode *tree, int falseLabel);
 
 
+/*
+ * Generate and return a new unique label.
+ */
+int genNewLabel(void);
+
 
 
 
-/*
- * genIfStmtt(): generates DCode to evaluate an IF statement.
- */
-void genIfStmt(TreeNode *tree);
 
 void genAssStmt(TreeNode *tree);
-/*
- * genWhileStmt(): generate DCode to evaluate a WHILE statement.
- */
-void genWhileStmt(TreeNode *tree);
 
 
 /*
@@ -126,10 +157,18 @@ void genCallStmt(TreeNode *tree);
 
 
 /*
- * varSize(): given a scalar/array declaration, computes the size of the
- *  variable, or returns 0 otherwise.
+ * genInlinedCall(): generates DCode for a call the inliner has replaced
+ *  with the function's body.
+ */
+static void genInlinedCall(TreeNode *tree);
+
+
+/*
+ * isTailCall(), genTailCall(): recognise and generate "return f(...)" as
+ *  a jump to f that reuses the current frame.
  */
-int varSize(TreeNode *tree);
+static int isTailCall(TreeNode *tree);
+static void genTailCall(TreeNode *call, TreeNode *function);
 
 
 /*********************************************************************
@@ -139,7 +178,7 @@ int varSize(TreeNode *tree);
 void codeGen(TreeNode *syntaxTree, char *fileName, char *moduleName)
 {
     /* attempt to open output file for writing */
-    output = fopen(fileName, "w");
+    output = fopen(fileName, BinaryObject ? "wb" : "w");
     if (output == NULL)
     {
         Error = TRUE;
@@ -150,149 +189,31 @@ void codeGen(TreeNode *syntaxTree, char *fileName, char *moduleName)
         /* begin code generation */
 
         /*
-         * There are three attributes that need to be synthesised before
-         *  code generation can begin.  They're the locals-on-the-stack
-         *  size, and the "assembly-area" size (assembly area is where
-         *  parameters for function calls are set up before execution), as
-         *  well as AP/LP stack-offsets for locals/parameters.
+         * The locals-on-the-stack size and the AP/LP stack-offsets for
+         *  locals/parameters were synthesised by the analyser, along
+         *  with everything else (see analyseProgram()).
          */
 
-        calcSizeAttribute(syntaxTree);
-        calcStackOffsets(syntaxTree);
-
         genProgram(syntaxTree, fileName, moduleName);
-    }
-}
-
-/*********************************************************************
- *  Static function definitions
- */
-
 
+        free(registerNeeds);
+        registerNeeds = NULL;
+        registerNeedCapacity = 0;
 
-
-void calcSizeAttribute(TreeNode *syntaxTree)
-{
-    int i;      /* used for iterating over tree-node children */
-    static int size;   /* amount of space locals are taking up on stack */
-
-    while (syntaxTree != NULL)
-    {
-        /*
-         * entering a function call?  the local area size obviously has
-         *  to be set to 0.
-         */
-
-        if ((syntaxTree->nodekind == DecK)
-                && (syntaxTree->kind.dec == FuncDecK) || (syntaxTree->isGlobal==TRUE))
-        {
-            size = 0;
-        }
-
-
-
-        /* visit children nodes */
-        for (i=0; i < MAXCHILDREN; ++i)
-            if(syntaxTree->child[i]!=NULL) calcSizeAttribute(syntaxTree->child[i]);
-
-        /* have we hit a local declaration? increase "size" */
-        if ((syntaxTree->nodekind == DecK)
-                && ((syntaxTree->kind.dec == ScalarDecK)
-                    || (syntaxTree->kind.dec == ArrayDecK))
-           )
-        {
-            if (syntaxTree->kind.dec == ScalarDecK)
-                size += WORDSIZE;
-            else if (syntaxTree->kind.dec == ArrayDecK && syntaxTree->isParameter==TRUE)
-                size += WORDSIZE;
-            else if (syntaxTree->kind.dec == ArrayDecK && syntaxTree->isParameter==FALSE)
-                size += (WORDSIZE * syntaxTree->val);
-            /* record the attribute */
-            syntaxTree->localSize = size;
-        }
-
-        /* leaving a function? record attribute in function-dec node */
-        if ((syntaxTree->nodekind == DecK)
-                && (syntaxTree->kind.dec == FuncDecK))
-        {
-            /* debug output */
-            DEBUG_ONLY( fprintf(listing,
-                                "*** Calculated localSize attribute for %s() as %d.\n",
-                                syntaxTree->name, size+3); );
-
-            syntaxTree->localSize = size+3;
-        }
-
-        syntaxTree = syntaxTree->sibling;
-        if (syntaxTree==NULL)
-        {
-            return;
-        }
-
+        /* the code has been kept in memory until now */
+        if (OptimiseLevel >= 1)
+            optimiseCode(OptimiseLevel);
+        if (BinaryObject)
+            writeObject(output, ObjectTables);
+        else
+            writeCode(output);
+        fclose(output);
     }
 }
 
-
-/*
- * Traverses the AST calculating AP/LP offsets for function parameters/
- *  function locals respectively.
+/*********************************************************************
+ *  Static function definitions
  */
-void calcStackOffsets(TreeNode *syntaxTree)
-{
-    int i;      /* used for iterating over tree-node children */
-
-    /* offsets for LP and AP respectively */
-    static int GP=0;
-    static int LP=0;
-
-
-    while (syntaxTree != NULL)
-    {
-        /* If we're entering a function, reset offset counters to 0 */
-        if ((syntaxTree->nodekind==DecK) && (syntaxTree->kind.dec==FuncDecK))
-        {
-
-            LP = -2;
-        }
-
-        /* visit children nodes */
-        for (i=0; i < MAXCHILDREN; ++i)
-            if(syntaxTree->child[i]!=NULL) calcStackOffsets(syntaxTree->child[i]);
-
-        /* post-order stuff goes here */
-        if ((syntaxTree->nodekind == DecK) &&
-                ((syntaxTree->kind.dec==ArrayDecK)
-                 ||(syntaxTree->kind.dec==ScalarDecK)))
-        {
-            if (syntaxTree->isGlobal)
-            {
-                syntaxTree->offset = GP;
-                GP += varSize(syntaxTree);
-
-                DEBUG_ONLY(
-                    fprintf(listing,
-                            "*** computed offset attribute for %s as %d\n",
-                            syntaxTree->name, syntaxTree->offset); );
-            }
-            else
-            {
-
-                LP -= varSize(syntaxTree);
-                syntaxTree->offset = LP;
-
-                DEBUG_ONLY(
-                    fprintf(listing,
-                            "*** computed offset attribute for %s as %d\n",
-                            syntaxTree->name, syntaxTree->offset); );
-
-            }
-        }
-
-        syntaxTree = syntaxTree->sibling;
-    }
-}
-
-
 
 
 
@@ -325,15 +246,28 @@ void genTopLevelDecl(TreeNode *tree)
 
     while (current != NULL)
     {
-        if ((current->nodekind == DecK) && (current->kind.dec == ScalarDecK))
+        if (!DECINFO(current)->isReachable)
+        {
+            /* nothing reachable from main() uses it (see markReachable()) */
+            if (TraceCode)
+            {
+                emitCommentSeparator();
+                sprintf(commentBuffer, "\"%.40s\" is never used: left out\n",
+                        current->name);
+                emitComment(commentBuffer);
+            }
+        }
+        else if ((current->nodekind == DecK) && (current->kind.dec == ScalarDecK))
         {
             /* scalar */
+            emitData(current->name, DECINFO(current)->offset,
+                     DECINFO(current)->localSize);
             if (TraceCode)
             {
                 emitCommentSeparator();
                 sprintf(commentBuffer,
                         "Variable \"%s\" is a scalar of type %s\n",
-                        current->name, typeName(current->variableDataType));
+                        current->name, typeName(DECINFO(current)->variableDataType));
                 emitComment(commentBuffer);
             }
 
@@ -341,21 +275,23 @@ void genTopLevelDecl(TreeNode *tree)
         else if ((current->nodekind==DecK)&&(current->kind.dec==ArrayDecK))
         {
             /* array */
+            emitData(current->name, DECINFO(current)->offset,
+                     DECINFO(current)->localSize);
             if (TraceCode)
             {
                 emitCommentSeparator();
                 if (current->val==0)
                 {
-                    assert(current->isParameter==TRUE);
+                    assert(DECINFO(current)->isParameter==TRUE);
                     sprintf(commentBuffer,
                             "Variable \"%s\" is an array of type %s and size unknow and is parameter.\n",
-                            current->name, typeName(current->variableDataType)
+                            current->name, typeName(DECINFO(current)->variableDataType)
                            );
                 }
                 else
                     sprintf(commentBuffer,
                             "Variable \"%s\" is an array of type %s and size %d\n",
-                            current->name, typeName(current->variableDataType),
+                            current->name, typeName(DECINFO(current)->variableDataType),
                             current->val);
                 emitComment(commentBuffer);
             }
@@ -368,7 +304,7 @@ void genTopLevelDecl(TreeNode *tree)
             genFunction(current);
         }
 
-        current = current->sibling;
+        current = NODE(current->sibling);
     }
 }
 
@@ -404,25 +340,32 @@ void genFunction(TreeNode *tree)
     }
     /* emit function header */
 
-    sprintf(commentBuffer,"%s",tree->name);
-    emitLabel(commentBuffer,"function entry");
+    emitSourceLine(tree->lineno);
+    emitLabel(nameLabel(tree->name),"function entry");
     /* make sure all local variables get declared */
     genFunctionLocals(tree);
-    tmpOffset = -tree->localSize;
+    tmpOffset = -DECINFO(tree)->localSize;
 
     /* begin of procedure, make it so */
-    emitRM("ST",ac,retFO,mp,"ret from call");
-    emitRO("LDC",ac,tmpOffset,ac,"get function stack size");
-    emitRM("ST",ac,initFO,mp,"set stack size");
-    genStatement(tree->child[1]);
+    emitRM(opST,ac,retFO,mp,"ret from call");
+    emitRO(opLDC,ac,tmpOffset,ac,"get function stack size");
+    emitRM(opST,ac,initFO,mp,"set stack size");
+
+    /* a tail call to the function itself comes back in here */
+    if (OptimiseLevel >= 1)
+    {
+        functionBody = genNewLabel();
+        emitLabel(functionBody,"function body");
+    }
+    genStatement(NODE(tree->child[1]));
 
     /* end of procedure, make it so */
     if (strcmp(tree->name,"main")==0)
     {
-        emitRO("HALT",0,0,0,"halt");
+        emitRO(opHALT,0,0,0,"halt");
     }
     else
-        emitRM("LD",pc,retFO,mp,"ret from call");
+        emitRM(opLD,pc,retFO,mp,"ret from call");
 
 }
 
@@ -444,8 +387,8 @@ void genFunctionLocals(TreeNode *tree)
     int i;
 
     for (i=0; i<MAXCHILDREN; ++i)
-        if (tree->child[i] != NULL)
-            genFunctionLocals2(tree->child[i]);
+        if (tree->child[i] != 0)
+            genFunctionLocals2(NODE(tree->child[i]));
 }
 
 void genFunctionLocals2(TreeNode *tree)
@@ -455,19 +398,19 @@ void genFunctionLocals2(TreeNode *tree)
      * declarations, and emit code to declare them.
      */
 
-    int i;
+    TreeWalk walk;
+    int step;
     int offset; /* "offset" for .LOCAL declaration */
     char commentBuffer[80];
 
-    while (tree != NULL)
-    {
-        /* preorder operations go here */
+    startWalk(&walk, tree);
 
-        for (i=0; i < MAXCHILDREN; ++i)
-            genFunctionLocals2(tree->child[i]);
+    while ((step = walkTree(&walk)) != WALKDONE)
+    {
+        tree = walk.node;
 
         /* postorder operations go here */
-        if (tree->nodekind==DecK)
+        if ((step == WALKLEAVE) && (tree->nodekind==DecK))
         {
 
 
@@ -476,7 +419,7 @@ void genFunctionLocals2(TreeNode *tree)
 
 
 
-            offset = tree->offset;
+            offset = DECINFO(tree)->offset;
             sprintf(commentBuffer,"LOCAL _%s %d,%d",tree->name, offset, varSize(tree));
 
             emitComment(commentBuffer);
@@ -484,20 +427,68 @@ void genFunctionLocals2(TreeNode *tree)
 
 
         }
-
-        tree = tree->sibling;
     }
+
+    endWalk(&walk);
 }
 
 
+/*
+ * Statements nest, and a deeply nested program mustn't run genStatement()
+ *  out of C stack, so it keeps its own stack of StatementFrames: one for
+ *  each statement list it's part-way through.  IF and WHILE statements
+ *  are generated a part at a time, around the lists they contain.
+ */
+
+typedef struct
+{
+    TreeNode *current;   /* the statement being generated */
+    int      part;       /* the part of it to generate next */
+    int      label1;     /* an IF's else-label, or a WHILE's start-label */
+    int      label2;     /* the end-label of either */
+} StatementFrame;
+
+
 void genStatement(TreeNode *tree)
 {
-    TreeNode *current;
+    StatementFrame *frames = NULL;
+    StatementFrame *frame;
+    int            count = 0;
+    int            capacity = 0;
+    TreeNode       *current;
+    TreeNode       *body;     /* a statement list to generate next */
 
-    current = tree;
+    body = tree;
 
-    while (current != NULL)
+    for (;;)
     {
+        /* starting on a statement list? */
+        if (body != NULL)
+        {
+            frames = (StatementFrame*)growStack(frames, count, &capacity,
+                                                sizeof(StatementFrame));
+            frames[count].current = body;
+            frames[count].part = 0;
+            ++count;
+
+            body = NULL;
+        }
+
+        if (count == 0)
+            break;
+
+        frame = &frames[count - 1];
+        current = frame->current;
+
+        /* finished this list? pick up where the enclosing one left off */
+        if (current == NULL)
+        {
+            --count;
+            continue;
+        }
+
+        emitSourceLine(current->lineno);
+
         /* assignment */
         if ((current->nodekind==ExpK) && (current->kind.exp==AssignK))
         {
@@ -513,12 +504,61 @@ void genStatement(TreeNode *tree)
             {
             case IfK:
 
-                genIfStmt(current);
+                if (frame->part == 0)
+                {
+                    frame->label1 = genNewLabel();   /* else-label */
+                    frame->label2 = genNewLabel();   /* end-label  */
+
+                    /* test expression */
+                    emitComment("IF statement");
+                    emitComment("if false, jump to else-part");
+                    genCondition(NODE(current->child[0]), frame->label1);
+
+                    frame->part = 1;
+                    body = NODE(current->child[1]);  /* then-part */
+                    continue;
+                }
+                else if (frame->part == 1)
+                {
+                    emitGoto(opLDA,pc,frame->label2,"endLabel");
+
+                    /* emit else-part label */
+                    emitLabel(frame->label1,"elseLabel");
+
+                    frame->part = 2;
+                    body = NODE(current->child[2]);  /* else-part */
+                    continue;
+                }
+
+                /* emit end-label */
+                emitLabel(frame->label2,"endLabel");
                 break;
 
             case WhileK:
 
-                genWhileStmt(current);
+                if (frame->part == 0)
+                {
+                    frame->label1 = genNewLabel();   /* start-label */
+                    frame->label2 = genNewLabel();   /* end-label   */
+
+                    emitComment("WHILE statement");
+                    emitComment("if expression evaluates to FALSE, exit loop");
+
+                    /* emit start label */
+                    emitLabel(frame->label1,"startLabel");
+                    /* generate conditional branch */
+                    genCondition(NODE(current->child[0]), frame->label2);
+
+                    frame->part = 1;
+                    body = NODE(current->child[1]);  /* emit body */
+                    continue;
+                }
+
+                /* emit branch to start */
+                emitGoto(opLDA,pc,frame->label1,"startLabel");
+
+                /* generate end label */
+                emitLabel(frame->label2,"endLabel");
                 break;
 
             case ReturnK:
@@ -531,27 +571,141 @@ void genStatement(TreeNode *tree)
                 genCallStmt(current);
                 break;
 
+            case InlineK:
+
+                genInlinedCall(current);
+                break;
+
             case CompoundK:
 
-                genStatement(current->child[1]);
+                if (frame->part == 0)
+                {
+                    frame->part = 1;
+                    body = NODE(current->child[1]);
+                    continue;
+                }
                 break;
             }
         }
 
-        current = current->sibling;
+        /* on to the next statement in this list */
+        frame->current = NODE(current->sibling);
+        frame->part = 0;
     }
+
+    free(frames);
 }
 
 
 /*
- * Generate DCode for an Expression.
+ * Generate DCode for an Expression, leaving its value (or, if
+ *  addressNeeded, its address) in ac.
  */
 void genExpression(TreeNode *tree, int addressNeeded)
+{
+    labelExpression(tree);
+    genValue(tree, addressNeeded, ac);
+}
+
+
+/*
+ * labelExpression(): labels an expression tree, bottom up, with the
+ *  number of registers each subtree needs to be evaluated without
+ *  spilling (Sethi-Ullman numbering), and returns the root's.  A call or
+ *  an assignment is labelled as needing every register, since it uses
+ *  them all; their own operands get labelled when they're generated.
+ *  Subtrees with one in them are marked as CLOBBERS too.
+ *
+ * A chain of operators is walked down its left operands onto the spine
+ *  stack and labelled on the way back up, so that "a + b + c + ..."
+ *  only recurses for the right operands, however long it is.
+ */
+static int labelExpression(TreeNode *tree)
+{
+    int base = spineCount;
+    int left, right;
+    int need = 1;
+    int clobbers = 0;
+
+    while ((tree->nodekind == ExpK) && (tree->kind.exp == OpK))
+    {
+        spine = (TreeNode**)growStack(spine, spineCount, &spineCapacity,
+                                      sizeof(TreeNode*));
+        spine[spineCount++] = tree;
+        tree = NODE(tree->child[0]);
+    }
+
+    if (tree->nodekind == StmtK)
+    {
+        need = ALLREGS;   /* a call */
+        clobbers = CLOBBERS;
+    }
+    else if (tree->kind.exp == AssignK)
+    {
+        need = ALLREGS;
+        clobbers = CLOBBERS;
+    }
+    else if ((tree->kind.exp == IdK) && (tree->child[0] != 0))
+    {
+        need = labelExpression(NODE(tree->child[0]));   /* array index */
+        clobbers = CLOBBERING(NODE(tree->child[0]));
+    }
+    left = setNeed(tree, need, clobbers);
+
+    while (spineCount > base)
+    {
+        tree = spine[--spineCount];
+        right = labelExpression(NODE(tree->child[1]));
+        clobbers = CLOBBERING(NODE(tree->child[0]))
+                   | CLOBBERING(NODE(tree->child[1]));
+
+        if (left == right)
+            need = left + 1;
+        else
+            need = (left > right) ? left : right;
+        left = setNeed(tree, need, clobbers);
+    }
+
+    return left;
+}
+
+
+/*
+ * setNeed(): records the register need of a labelled node, and returns
+ *  it.
+ */
+static int setNeed(TreeNode *tree, int need, int clobbers)
+{
+    /* more than ALLREGS only ever means "it will spill" */
+    if (need > ALLREGS + 1)
+        need = ALLREGS + 1;
+
+    /* (each growth doubles it, and a node can be far past the last one) */
+    while (tree->index >= (NodeIndex)registerNeedCapacity)
+        registerNeeds = (unsigned char*)growStack(registerNeeds,
+                        registerNeedCapacity, &registerNeedCapacity,
+                        sizeof(unsigned char));
+    registerNeeds[tree->index] = (unsigned char)(need | clobbers);
+
+    return need;
+}
+
+
+/*
+ * genValue(): generates DCode to leave the value (or address) of a
+ *  labelled expression in register "reg".  Registers below "reg" hold
+ *  values that are still live; "reg" up to MAXREG are free to use.
+ *
+ * PRE: an operator is never generated into MAXREG, which is always true
+ *       of the registers labelExpression()'s numbering hands out.
+ */
+static void genValue(TreeNode *tree, int addressNeeded, int reg)
 {
     char scratch[80];   /* used for assembling arguments to instructions */
-    int loc=0;
-    TreeNode * p1=NULL, * p2=NULL;
+    TreeNode *declaration;   /* declaration of an identifier */
+    DecInfo  *decInfo;       /* and its declaration attributes */
 
+    emitSourceLine(tree->lineno);
     /* if it's an expression, eval as expression... */
     if (tree->nodekind == ExpK)
     {
@@ -559,35 +713,38 @@ void genExpression(TreeNode *tree, int addressNeeded)
         switch (tree->kind.exp)
         {
         case IdK:
-            if (tree->declaration->kind.dec == ArrayDecK)
+            declaration = NODE(tree->declaration);
+            decInfo = DECINFO(declaration);
+
+            if (declaration->kind.dec == ArrayDecK)
             {
 
                 /* are we just passing the name of an array as parameter?
                    Pass as reference */
-                if (tree->child[0]==NULL)
+                if (tree->child[0]==0)
                 {
                     emitComment("leave address of array on stack");
-                    if (tree->declaration->isGlobal) /* GLOBAL VARIABLE */
+                    if (decInfo->isGlobal) /* GLOBAL VARIABLE */
                     {
                         emitComment("push address of global variable");
 
 
-                        emitRM("LDA",ac,tree->declaration->offset,gp,"get the value");
+                        emitRM(opLDA,reg,decInfo->offset,gp,"get the value");
 
 
 
                     }
-                    else if (tree->declaration->isParameter)
+                    else if (decInfo->isParameter)
                     {
 
 
-                        emitRM("LD",ac,tree->declaration->offset,mp,"get the value");
+                        emitRM(opLD,reg,decInfo->offset,mp,"get the value");
 
 
                     }
                     else
                     {
-                        emitRM("LDA",ac,tree->declaration->offset,mp,"get the value");
+                        emitRM(opLDA,reg,decInfo->offset,mp,"get the value");
                     }
 
                 }
@@ -595,22 +752,22 @@ void genExpression(TreeNode *tree, int addressNeeded)
                 {
                     /* calculate array offset */
                     emitComment("calculate array offset");
-                    genExpression(tree->child[0], FALSE);
+                    genValue(NODE(tree->child[0]), FALSE, reg);
 
                     emitComment("get address of array onto stack");
-                    if (tree->declaration->isGlobal || tree->declaration->isParameter) /* GLOBAL VARIABLE */
+                    if (decInfo->isGlobal || decInfo->isParameter) /* GLOBAL VARIABLE */
                     {
                         emitComment("push address of global variable");
 
                         if (addressNeeded)
                         {
-                            emitRO("ADD",ac,ac,gp,"op: load left");
-                            emitRM("LDA",ac,0,ac,"get the value");
+                            emitRO(opADD,reg,reg,gp,"op: load left");
+                            emitRM(opLDA,reg,0,reg,"get the value");
                         }
                         else
                         {
-                            emitRO("ADD",ac,ac,gp,"op: load left");
-                            emitRM("LD",ac,0,ac,"get the value");
+                            emitRO(opADD,reg,reg,gp,"op: load left");
+                            emitRM(opLD,reg,0,reg,"get the value");
                         }
 
                     }
@@ -620,13 +777,13 @@ void genExpression(TreeNode *tree, int addressNeeded)
 
                         if (addressNeeded)
                         {
-                            emitRO("ADD",ac,ac,mp,"op: load left");
-                            emitRM("LDA",ac,tree->declaration->offset,ac,"get the value");
+                            emitRO(opADD,reg,reg,mp,"op: load left");
+                            emitRM(opLDA,reg,decInfo->offset,reg,"get the value");
                         }
                         else
                         {
-                            emitRO("ADD",ac,ac,mp,"op: load left");
-                            emitRM("LD",ac,tree->declaration->offset,ac,"get the value");
+                            emitRO(opADD,reg,reg,mp,"op: load left");
+                            emitRM(opLD,reg,decInfo->offset,reg,"get the value");
                         }
                     }
 
@@ -634,12 +791,12 @@ void genExpression(TreeNode *tree, int addressNeeded)
                 }
 
             }
-            else if (tree->declaration->kind.dec == ScalarDecK)
+            else if (declaration->kind.dec == ScalarDecK)
             {
 
                 /* get effective address */
                 emitComment("calculate effective address of variable");
-                if (tree->declaration->isGlobal)   /* GLOBAL VARIABLE */
+                if (decInfo->isGlobal)   /* GLOBAL VARIABLE */
                 {
                     if (TraceCode) emitComment("->global Id") ;
 
@@ -647,12 +804,12 @@ void genExpression(TreeNode *tree, int addressNeeded)
                     if (addressNeeded)
                     {
 
-                        emitRM("LDA",ac,tree->declaration->offset,mp,"get the value");
+                        emitRM(opLDA,reg,decInfo->offset,mp,"get the value");
                     }
                     else
                     {
 
-                        emitRM("LD",ac,tree->declaration->offset,mp,"get the value");
+                        emitRM(opLD,reg,decInfo->offset,mp,"get the value");
                     }
                     if (TraceCode)  emitComment("<- Id") ;
                 }
@@ -663,12 +820,12 @@ void genExpression(TreeNode *tree, int addressNeeded)
                     if (addressNeeded)
                     {
 
-                        emitRM("LDA",ac,tree->declaration->offset,mp,"get the value");
+                        emitRM(opLDA,reg,decInfo->offset,mp,"get the value");
                     }
                     else
                     {
 
-                        emitRM("LD",ac,tree->declaration->offset,mp,"get the value");
+                        emitRM(opLD,reg,decInfo->offset,mp,"get the value");
                     }
                 }
 
@@ -682,238 +839,339 @@ void genExpression(TreeNode *tree, int addressNeeded)
 
         case OpK:
 
-            /* compute operands */
-
-            if (TraceCode) emitComment("-> Op") ;
-            p1 = tree->child[0];
-            p2 = tree->child[1];
-            /* gen code for ac = left arg */
-            genExpression(p1,FALSE);
-            /* gen code to push left operand */
-            //emitRO("ADD",ac1,gp,ac,"move ac to ac1");
-            emitRM("ST",ac,tmpOffset--,mp,"push");
-            /* gen code for ac = right operand */
-            genExpression(p2,FALSE);
-            /* now load left operand */
-            emitRM("LD",ac1,++tmpOffset,mp,"pop");
-            switch (tree->op)
-            {
-
-            case PLUS:
-
-
-                emitRO("ADD",ac,ac1,ac,"*op +");
-                break;
-
-            case MINUS:
-                emitRO("SUB",ac,ac1,ac,"*op -");
-
-                break;
-
-            case TIMES:
-                emitRO("MUL",ac,ac1,ac,"*op *");
-
-                break;
+            genChain(tree, reg);
+            break;
 
-            case DIVIDE:
-                emitRO("DIV",ac,ac1,ac,"*op /");
+        case ConstK:
 
-                break;
+            sprintf(scratch, "* pshLit  %d", tree->val);
+            emitRM(opLDC,reg,tree->val,reg,"get the value");
 
-            case LT:
-                emitRO("SUB",ac,ac1,ac,"op <") ; // ac = ac1-ac(left-right)
-                emitRM("JLT",ac,2,pc,"br if true") ; //ac<0 (left<right) goto pc+3
-                emitRM("LDC",ac,0,ac,"false case") ; //else ac=0
-                emitRM("LDA",pc,1,pc,"unconditional jmp") ; //pc=pc+2
-                emitRM("LDC",ac,1,ac,"true case") ; //ac=1
+            break;
 
-                break;
+        case AssignK:
 
-            case GT:
-                emitRO("SUB",ac,ac1,ac,"op >") ; // ac = ac1-ac(left-right)
-                emitRM("JGT",ac,2,pc,"br if true") ; //a>0 (left>right) goto pc+3
-                emitRM("LDC",ac,0,ac,"false case") ; //else ac=0
-                emitRM("LDA",pc,1,pc,"unconditional jmp") ; //pc=pc+2
-                emitRM("LDC",ac,1,ac,"true case") ; //ac=1
+            genClobbering(tree, reg);
+            break;
 
-                break;
+        }
+    }
+    else if (tree->nodekind == StmtK)
+    {
+        if ((tree->kind.stmt == CallK) || (tree->kind.stmt == InlineK))
+        {
+            genClobbering(tree, reg);
+        }
+    }
+}
 
-            case NE:
-                emitRO("SUB",ac,ac1,ac,"op !=") ; // ac = ac1-ac(left-right)
-                emitRM("JNE",ac,2,pc,"br if true") ; //ac!=0 (left!=right) goto pc+3
-                emitRM("LDC",ac,0,ac,"false case") ; //else ac=0
-                emitRM("LDA",pc,1,pc,"unconditional jmp") ; //pc=pc+2
-                emitRM("LDC",ac,1,ac,"true case") ; //ac=1
 
-                break;
+/*
+ * genChain(): generates DCode for an operator into "reg".  Operators
+ *  whose left operand is another operator, generated first, are walked
+ *  down onto the spine stack, and each one's right operand and its
+ *  instruction are generated on the way back up: a long chain like
+ *  "a + b + c + ..." doesn't recurse once per operator.
+ *
+ * PRE: emitSourceLine() has been called for "tree".
+ */
+static void genChain(TreeNode *tree, int reg)
+{
+    int      base = spineCount;
+    int      left, right;     /* the registers the operands end up in */
+    TreeNode *operand;
 
-            case LTE:
-                emitRO("SUB",ac,ac1,ac,"op <=") ; // ac = ac1-ac(left-right)
-                emitRM("JLE",ac,2,pc,"br if true") ; //ac<=0 (left<=right) goto pc+3
-                emitRM("LDC",ac,0,ac,"false case") ; //else ac=0
-                emitRM("LDA",pc,1,pc,"unconditional jmp") ; //pc=pc+2
-                emitRM("LDC",ac,1,ac,"true case") ; //ac=1
+    for (;;)
+    {
+        if (TraceCode) emitComment("-> Op") ;
 
-                break;
+        operand = NODE(tree->child[0]);
+        if ((operand->nodekind != ExpK) || (operand->kind.exp != OpK)
+                || !leftFirst(tree))
+            break;
 
-            case GTE:
-                emitRO("SUB",ac,ac1,ac,"op >=") ; // ac = ac1-ac(left-right)
-                emitRM("JGE",ac,2,pc,"br if true") ; //ac>=0 (left>=right) goto pc+3
-                emitRM("LDC",ac,0,ac,"false case") ; //else ac=0
-                emitRM("LDA",pc,1,pc,"unconditional jmp") ; //pc=pc+2
-                emitRM("LDC",ac,1,ac,"true case") ; //ac=1
+        spine = (TreeNode**)growStack(spine, spineCount, &spineCapacity,
+                                      sizeof(TreeNode*));
+        spine[spineCount++] = tree;
+        tree = operand;
+        emitSourceLine(tree->lineno);
+    }
 
-                break;
+    genOperands(tree, reg, &left, &right);
+    genOperator(tree, reg, left, right);
 
-            case EQ:
-                emitRO("SUB",ac,ac1,ac,"op ==") ; // ac = ac1-ac(left-right)
-                emitRM("JEQ",ac,2,pc,"br if true") ; //ac==0 (left==right) goto pc+3
-                emitRM("LDC",ac,0,ac,"false case") ; //else ac=0
-                emitRM("LDA",pc,1,pc,"unconditional jmp") ; //pc=pc+2
-                emitRM("LDC",ac,1,ac,"true case") ; //ac=1
+    while (spineCount > base)
+    {
+        operand = tree;
+        tree = spine[--spineCount];
+        genSecondOperand(tree, operand, reg, &left, &right);
+        genOperator(tree, reg, left, right);
+    }
+}
 
-                break;
 
-            default:
-                abort();
-            }
+/*
+ * leftFirst(): tells whether an operator's left operand is generated
+ *  before its right one: if it needs at least as many registers, or if
+ *  either has a call or an assignment in it, so that what they do
+ *  happens in the same order.
+ */
+static int leftFirst(TreeNode *tree)
+{
+    TreeNode *p1 = NODE(tree->child[0]);
+    TreeNode *p2 = NODE(tree->child[1]);
 
-            break;
+    return (NEED(p1) >= NEED(p2)) || CLOBBERING(p1) || CLOBBERING(p2);
+}
 
-        case ConstK:
 
-            sprintf(scratch, "* pshLit  %d", tree->val);
-            emitRM("LDC",ac,tree->val,ac,"get the value");
+/*
+ * genOperands(): generates DCode for both operands of an operator, the
+ *  one that needs more registers first, leaving them in "reg" and
+ *  "reg"+1 in some order: which is which comes back in "left" and "right".
+ *  If either has a call or an assignment in it, though, the left one
+ *  always goes first, so that what they do happens in the same order.
+ */
+static void genOperands(TreeNode *tree, int reg, int *left, int *right)
+{
+    TreeNode *first;  /* the operand generated first */
 
-            break;
+    first = NODE(tree->child[leftFirst(tree) ? 0 : 1]);
+    genValue(first, FALSE, reg);
+    genSecondOperand(tree, first, reg, left, right);
+}
 
-        case AssignK:
 
-            genAssStmt(tree);
-            break;
+/*
+ * genSecondOperand(): generates DCode for the other operand of an
+ *  operator, once "first" has been generated into "reg", as for
+ *  genOperands().
+ */
+static void genSecondOperand(TreeNode *tree, TreeNode *first, int reg,
+                             int *left, int *right)
+{
+    TreeNode *p1 = NODE(tree->child[0]);
+    TreeNode *second = (first == p1) ? NODE(tree->child[1]) : p1;
 
-        }
+    if (NEED(second) <= MAXREG - reg)
+    {
+        /* the other fits in the registers that are left */
+        genValue(second, FALSE, reg + 1);
+        *left = (first == p1) ? reg : reg + 1;
     }
-    else if (tree->nodekind == StmtK)
+    else
     {
-        if (tree->kind.stmt == CallK)
-        {
-            genCallStmt(tree);
-        }
+        /* it doesn't: keep the first in memory meanwhile */
+        emitRM(opST,reg,tmpOffset--,mp,"spill");
+        genValue(second, FALSE, reg);
+        emitRM(opLD,reg + 1,++tmpOffset,mp,"reload");
+        *left = (first == p1) ? reg + 1 : reg;
     }
+    *right = (*left == reg) ? reg + 1 : reg;
 }
 
 
 /*
- * Generate and return a new unique label.
+ * genOperator(): generates the DCode for an operator whose operands are
+ *  in registers "left" and "right", leaving its value in "reg".
  */
-char *genNewLabel(void)
+static void genOperator(TreeNode *tree, int reg, int left, int right)
 {
-    static int nextLabel = 0;
-    char labelBuffer[40];
+    switch (tree->op)
+    {
 
+    case PLUS:
 
-    sprintf(labelBuffer, "label%d", nextLabel++);
-    return copyString(labelBuffer);
-}
 
+        emitRO(opADD,reg,left,right,"*op +");
+        break;
 
+    case MINUS:
+        emitRO(opSUB,reg,left,right,"*op -");
 
+        break;
 
+    case TIMES:
+        emitRO(opMUL,reg,left,right,"*op *");
 
-/*
- * genIfStmtt(): generates DCode to evaluate an IF statement.
- */
-void genIfStmt(TreeNode *tree)
-{
-    char *elseLabel;
-    char *endLabel;
+        break;
+
+    case DIVIDE:
+        emitRO(opDIV,reg,left,right,"*op /");
 
-    elseLabel = genNewLabel();
-    endLabel = genNewLabel();
+        break;
 
-    /* test expression */
-    emitComment("IF statement");
-    emitComment("if false, jump to else-part");
-    genExpression(tree->child[0], FALSE);
+    case LT:
+        emitRO(opSUB,reg,left,right,"op <") ; // reg = left-right
+        emitRM(opJLT,reg,2,pc,"br if true") ; //reg<0 (left<right) goto pc+3
+        emitRM(opLDC,reg,0,reg,"false case") ; //else reg=0
+        emitRM(opLDA,pc,1,pc,"unconditional jmp") ; //pc=pc+2
+        emitRM(opLDC,reg,1,reg,"true case") ; //reg=1
 
+        break;
 
-    emitGoto("JEQ",ac,elseLabel,gp,"else label");
+    case GT:
+        emitRO(opSUB,reg,left,right,"op >") ; // reg = left-right
+        emitRM(opJGT,reg,2,pc,"br if true") ; //reg>0 (left>right) goto pc+3
+        emitRM(opLDC,reg,0,reg,"false case") ; //else reg=0
+        emitRM(opLDA,pc,1,pc,"unconditional jmp") ; //pc=pc+2
+        emitRM(opLDC,reg,1,reg,"true case") ; //reg=1
 
+        break;
 
-    genStatement(tree->child[1]); /* then-part */
+    case NE:
+        emitRO(opSUB,reg,left,right,"op !=") ; // reg = left-right
+        emitRM(opJNE,reg,2,pc,"br if true") ; //reg!=0 (left!=right) goto pc+3
+        emitRM(opLDC,reg,0,reg,"false case") ; //else reg=0
+        emitRM(opLDA,pc,1,pc,"unconditional jmp") ; //pc=pc+2
+        emitRM(opLDC,reg,1,reg,"true case") ; //reg=1
 
-    emitGoto("LDA",pc,endLabel,gp,"endLabel");
+        break;
 
+    case LTE:
+        emitRO(opSUB,reg,left,right,"op <=") ; // reg = left-right
+        emitRM(opJLE,reg,2,pc,"br if true") ; //reg<=0 (left<=right) goto pc+3
+        emitRM(opLDC,reg,0,reg,"false case") ; //else reg=0
+        emitRM(opLDA,pc,1,pc,"unconditional jmp") ; //pc=pc+2
+        emitRM(opLDC,reg,1,reg,"true case") ; //reg=1
 
-    /* emit else-part label */
+        break;
 
+    case GTE:
+        emitRO(opSUB,reg,left,right,"op >=") ; // reg = left-right
+        emitRM(opJGE,reg,2,pc,"br if true") ; //reg>=0 (left>=right) goto pc+3
+        emitRM(opLDC,reg,0,reg,"false case") ; //else reg=0
+        emitRM(opLDA,pc,1,pc,"unconditional jmp") ; //pc=pc+2
+        emitRM(opLDC,reg,1,reg,"true case") ; //reg=1
 
-    emitLabel(elseLabel,"elseLabel");
-    genStatement(tree->child[2]);  /* else-part */
+        break;
 
-    /* emit end-label */
+    case EQ:
+        emitRO(opSUB,reg,left,right,"op ==") ; // reg = left-right
+        emitRM(opJEQ,reg,2,pc,"br if true") ; //reg==0 (left==right) goto pc+3
+        emitRM(opLDC,reg,0,reg,"false case") ; //else reg=0
+        emitRM(opLDA,pc,1,pc,"unconditional jmp") ; //pc=pc+2
+        emitRM(opLDC,reg,1,reg,"true case") ; //reg=1
 
+        break;
 
-    emitLabel(endLabel,"endLabel");
+    default:
+        abort();
+    }
 }
 
 
 /*
- * genWhileStmt(): generate DCode to evaluate a WHILE statement.
+ * genCondition(): generates DCode for the condition of an IF or a WHILE,
+ *  jumping to "falseLabel" if it's false.  A comparison's difference is
+ *  tested by the jump itself, without making a 0 or 1 of it first; a
+ *  constant condition needs no test at all.
  */
-void genWhileStmt(TreeNode *tree)
+void genCondition(TreeNode *tree, int falseLabel)
 {
-    char *startLabel;
-    char *endLabel;
-
+    int    left, right;
+    OpCode jump;   /* taken when the comparison is false */
 
-    startLabel = genNewLabel();
-    endLabel = genNewLabel();
+    if ((tree->nodekind == ExpK) && (tree->kind.exp == ConstK))
+    {
+        if (tree->val == 0)
+            emitGoto(opLDA,pc,falseLabel,"always false");
+        return;
+    }
 
-    emitComment("WHILE statement");
-    emitComment("if expression evaluates to FALSE, exit loop");
+    if ((tree->nodekind == ExpK) && (tree->kind.exp == OpK))
+    {
+        switch (tree->op)
+        {
+        case LT:  jump = opJGE; break;
+        case LTE: jump = opJGT; break;
+        case GT:  jump = opJLE; break;
+        case GTE: jump = opJLT; break;
+        case EQ:  jump = opJNE; break;
+        case NE:  jump = opJEQ; break;
+        default:  jump = opHALT;
+        }
 
-    /* emit start label */
+        if (jump != opHALT)
+        {
+            emitSourceLine(tree->lineno);
+            labelExpression(tree);
+            genOperands(tree, ac, &left, &right);
+            emitRO(opSUB,ac,left,right,"compare");  /* ac = left-right */
+            emitGoto(jump,ac,falseLabel,"branch if false");
+            return;
+        }
+    }
 
+    genExpression(tree, FALSE);
+    emitGoto(opJEQ,ac,falseLabel,"branch if false");
+}
 
-    emitLabel(startLabel,"startLabel");
-    genExpression(tree->child[0], FALSE);
 
-    /* generate conditional branch */
+/*
+ * genClobbering(): generates DCode for a call or an assignment, which
+ *  uses every register, into register "reg": the live registers below
+ *  it are kept on the stack meanwhile.
+ */
+static void genClobbering(TreeNode *tree, int reg)
+{
+    int i;
 
-    emitGoto("JEQ",ac,endLabel,gp,"endLabel");
-    /* emit body */
-    genStatement(tree->child[1]);
+    for (i = 0; i < reg; ++i)
+        emitRM(opST,i,tmpOffset--,mp,"save live register");
 
-    /* emit branch to start */
+    if ((tree->nodekind == StmtK) && (tree->kind.stmt == InlineK))
+        genInlinedCall(tree);
+    else if (tree->nodekind == StmtK)
+        genCallStmt(tree);
+    else
+        genAssStmt(tree);
 
-    emitGoto("LDA",pc,startLabel,gp,"startLabel");
+    if (reg != ac)
+        emitRM(opLDA,reg,0,ac,"move the result");
 
+    for (i = reg - 1; i >= 0; --i)
+        emitRM(opLD,i,++tmpOffset,mp,"restore live register");
+}
 
-    /* generate end label */
 
-    emitLabel(endLabel,"endLabel");
+/*
+ * Generate and return a new unique label.
+ */
+int genNewLabel(void)
+{
+    return newLabel();
 }
 
 
+
+
+
 /*
  * genReturnStatement(): generate DCode to evaluate a RETURN statement.
  */
 void genReturnStmt(TreeNode *tree)
 {
-    if (tree->declaration->functionReturnType != Void)
+    if (DECINFO(NODE(tree->declaration))->functionReturnType != Void)
     {
 
-        if (tree->child[0] != NULL)
-            genExpression(tree->child[0], FALSE);
+        if (isTailCall(tree))
+        {
+            genTailCall(NODE(tree->child[0]), NODE(tree->declaration));
+            return;
+        }
+        else if (tree->child[0] != 0)
+            genExpression(NODE(tree->child[0]), FALSE);
         else
 
-            emitRO("LDC",ac,0,ac,"return 0");
+            emitRO(opLDC,ac,0,ac,"return 0");
 
 
     }
-    emitRO("LD",pc,retFO,mp,"return to call place");
+    if (inlineExit >= 0)
+        emitGoto(opLDA,pc,inlineExit,"return from inlined call");
+    else
+        emitRO(opLD,pc,retFO,mp,"return to call place");
 }
 
 
@@ -927,50 +1185,189 @@ void genCallStmt(TreeNode *tree)
     TreeNode *argPtr;   /* iterate over function arguments */
     TreeNode* calledFunc;
     HashNodePtr calledFuncHash;
-    argPtr = tree->child[0];
+    argPtr = NODE(tree->child[0]);
     offset=tmpOffset;
-    emitRM("ST",mp,tmpOffset--,mp,"save ofp"); //ofp
+    emitRM(opST,mp,tmpOffset--,mp,"save ofp"); //ofp
     tmpOffset--;//for ret
     calledFuncHash = lookupSymbol(tree->name);
     assert(calledFuncHash!=NULL);
     calledFunc = calledFuncHash->declaration;
-    emitRO("LDC",ac,-calledFunc->localSize,ac,"the func stack size");
-    emitRM("ST",ac,tmpOffset--,mp,"save init");
+    emitRO(opLDC,ac,-DECINFO(calledFunc)->localSize,ac,"the func stack size");
+    emitRM(opST,ac,tmpOffset--,mp,"save init");
 
     while (argPtr != NULL)
     {
         genExpression(argPtr, FALSE);
 
-        emitRM("ST",ac,tmpOffset--,mp,"push args");
+        emitRM(opST,ac,tmpOffset--,mp,"push args");
         ++numPars;
-        argPtr = argPtr->sibling;
+        argPtr = NODE(argPtr->sibling);
     }
-    emitRM("LDA",mp,offset,mp,"change the fp");
-    emitRO("LDA",ac,1,pc,"save ret in ac");
+    emitRM(opLDA,mp,offset,mp,"change the fp");
+    emitRO(opLDA,ac,1,pc,"save ret in ac");
 
-    emitGoto("LDA",pc,tree->name,gp,"func call");
-    emitRM("LD",mp,ofpFO,mp,"restore old fp");
+    emitGoto(opLDA,pc,nameLabel(tree->name),"func call");
+    emitRM(opLD,mp,ofpFO,mp,"restore old fp");
     tmpOffset=offset;
 
 }
+
+
+/*
+ * genInlinedCall(): generates DCode for a call that the inliner has
+ *  replaced with a copy of the function's body (see inlineCalls()).  Its
+ *  variables are in this function's frame already, so it's generated as
+ *  a compound statement would be, but with each return jumping to the
+ *  end of it, the value (if any) in ac.
+ */
+static void genInlinedCall(TreeNode *tree)
+{
+    int outerExit = inlineExit;
+    char commentBuffer[80];
+
+    sprintf(commentBuffer, "-> inlined call to \"%.40s()\"", tree->name);
+    emitComment(commentBuffer);
+
+    inlineExit = genNewLabel();
+    genStatement(NODE(tree->child[1]));
+    emitLabel(inlineExit,"end of inlined call");
+    inlineExit = outerExit;
+
+    emitComment("<- inlined call");
+}
+
+
+/*
+ * isTailCall(): is a RETURN statement's value a call that can reuse this
+ *  function's frame?  The callee's parameters have to fit in the frame,
+ *  and the frame mustn't hold an array being passed to it.  Tail calls
+ *  are made at -O1 and above, but not from main(), nor from an inlined
+ *  body, which isn't in its own function's frame.
+ */
+static int isTailCall(TreeNode *tree)
+{
+    TreeNode *call = NODE(tree->child[0]);
+    TreeNode *function = NODE(tree->declaration);
+    TreeNode *callee;
+    TreeNode *node;
+    TreeNode *declaration;
+
+    if ((OptimiseLevel < 1) || (inlineExit >= 0) || (call == NULL)
+            || (call->nodekind != StmtK) || (call->kind.stmt != CallK)
+            || (strcmp(function->name,"main") == 0))
+        return FALSE;
+
+    /* input() and output() have no body to jump into */
+    callee = NODE(call->declaration);
+    if (callee->child[1] == 0)
+        return FALSE;
+
+    for (node = NODE(callee->child[0]); node != NULL;
+            node = NODE(node->sibling))
+        if (DECINFO(node)->offset <= -DECINFO(function)->localSize)
+            return FALSE;
+
+    for (node = NODE(call->child[0]); node != NULL;
+            node = NODE(node->sibling))
+    {
+        if ((node->nodekind != ExpK) || (node->kind.exp != IdK)
+                || (node->child[0] != 0))
+            continue;
+
+        declaration = NODE(node->declaration);
+        if ((declaration->kind.dec == ArrayDecK)
+                && !DECINFO(declaration)->isGlobal
+                && !DECINFO(declaration)->isParameter)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/*
+ * genTailCall(): generates DCode for "return f(...)" that overwrites the
+ *  parameters in this function's frame with f's arguments and jumps to f,
+ *  which then returns straight to this function's caller.  The arguments
+ *  may use the parameters, so all but the last are kept below the frame
+ *  until every one of them has been worked out.  A call to the function
+ *  itself jumps past its prologue, since the return address is in place
+ *  already; any other goes in through the entry, with the return address
+ *  in ac as usual.
+ */
+static void genTailCall(TreeNode *call, TreeNode *function)
+{
+    TreeNode *callee = NODE(call->declaration);
+    TreeNode *argument;
+    TreeNode *parameter;
+    int      offset = tmpOffset;   /* where the arguments are kept */
+    int      kept;
+
+    emitComment("tail call");
+
+    parameter = NODE(callee->child[0]);
+    for (argument = NODE(call->child[0]); argument != NULL;
+            argument = NODE(argument->sibling))
+    {
+        genExpression(argument, FALSE);
+        if (argument->sibling != 0)
+            emitRM(opST,ac,tmpOffset--,mp,"keep argument");
+        else
+            emitRM(opST,ac,DECINFO(parameter)->offset,mp,"last argument");
+        parameter = NODE(parameter->sibling);
+    }
+
+    kept = offset;
+    for (parameter = NODE(callee->child[0]); kept > tmpOffset;
+            parameter = NODE(parameter->sibling))
+    {
+        emitRM(opLD,ac,kept--,mp,"kept argument");
+        emitRM(opST,ac,DECINFO(parameter)->offset,mp,"into parameter");
+    }
+    tmpOffset = offset;
+
+    if (callee == function)
+        emitGoto(opLDA,pc,functionBody,"tail call to itself");
+    else
+    {
+        emitRM(opLD,ac,retFO,mp,"pass on the return address");
+        emitGoto(opLDA,pc,nameLabel(callee->name),"tail call");
+    }
+}
+
+
 void genAssStmt(TreeNode *tree)
 {
+    TreeNode *lvalue = NODE(tree->child[0]);
+
     /* generate code to find rvalue (value) */
     emitComment("calculate the rvalue of the assignment");
-    genExpression(tree->child[1], FALSE);
-
-    /* gen code to push left operand */
-    emitRM("ST",ac,tmpOffset--,mp,"push");
+    genExpression(NODE(tree->child[1]), FALSE);
 
     /* find lvalue (address) */
     emitComment("calculate the lvalue of the assignment");
-    genExpression(tree->child[0], TRUE);
-    /* now load left operand */
-    emitRM("LD",ac1,++tmpOffset,mp,"pop");
-    /* do assignment */
-    emitComment("perform assignment");
+    if (labelExpression(lvalue) <= MAXREG)
+    {
+        /* keep the rvalue in ac while the address goes in ac1 */
+        genValue(lvalue, TRUE, ac1);
+        /* do assignment */
+        emitComment("perform assignment");
 
-    emitRM("ST",ac1,0,ac,"assign");
+        emitRM(opST,ac,0,ac1,"assign");
+    }
+    else
+    {
+        /* gen code to push left operand */
+        emitRM(opST,ac,tmpOffset--,mp,"push");
+        genValue(lvalue, TRUE, ac);
+        /* now load left operand */
+        emitRM(opLD,ac1,++tmpOffset,mp,"pop");
+        /* do assignment */
+        emitComment("perform assignment");
+
+        emitRM(opST,ac1,0,ac,"assign");
+        emitRM(opLDA,ac,0,ac1,"the value assigned");
+    }
 }
 
 /*
@@ -980,24 +1377,24 @@ void genAssStmt(TreeNode *tree)
 void genProgram(TreeNode *tree, char *fileName, char *moduleName)
 {
 
-    emitRM("LD",mp,0,0,"load max address from mem[0]");
-    emitRM("ST",0,0,0,"clear mem[0]");
-    emitGoto("LDA",pc,"main",gp,"goto main");
-    emitLabel("input","input methond");
-    emitRM("ST",ac,retFO,mp,"save ret in ac");
-    emitRO("IN",ac,0,0,"input");
-    emitRM("LD",pc,retFO,mp,"load pc back");
+    emitRM(opLD,mp,0,0,"load max address from mem[0]");
+    emitRM(opST,0,0,0,"clear mem[0]");
+    emitGoto(opLDA,pc,nameLabel(internName("main")),"goto main");
+    emitLabel(nameLabel(internName("input")),"input methond");
+    emitRM(opST,ac,retFO,mp,"save ret in ac");
+    emitRO(opIN,ac,0,0,"input");
+    emitRM(opLD,pc,retFO,mp,"load pc back");
 
-    emitLabel("output","output methond");
-    emitRM("ST",ac,retFO,mp,"save ret in ac");
-    emitRM("LD",ac,-3,mp,"load args");
-    emitRO("OUT",ac,0,0,"output");
-    emitRM("LD",pc,retFO,mp,"load pc back");
+    emitLabel(nameLabel(internName("output")),"output methond");
+    emitRM(opST,ac,retFO,mp,"save ret in ac");
+    emitRM(opLD,ac,-3,mp,"load args");
+    emitRO(opOUT,ac,0,0,"output");
+    emitRM(opLD,pc,retFO,mp,"load pc back");
 
 
     /* generate the rest of the program */
     genTopLevelDecl(tree);
-    emitRO("HALT",0,0,0,"halt");
+    emitRO(opHALT,0,0,0,"halt");
 }
 
 
@@ -1012,7 +1409,7 @@ int varSize(TreeNode *tree)
         else if (tree->kind.dec == ArrayDecK)
         {
             /* array parameters are passed by reference! */
-            if (tree->isParameter)
+            if (DECINFO(tree)->isParameter)
                 size = WORDSIZE;
             else
                 size = WORDSIZE * (tree->val);
@@ -31,6 +31,15 @@ extern int TraceCode;
 
 void codeGen(TreeNode *syntaxTree, char *fileName, char *moduleName);
 
+
+/*
+ * NAME:    varSize()
+ * PURPOSE: Given a scalar/array declaration, computes the size of the
+ *           variable, or returns 0 otherwise.
+ */
+
+int varSize(TreeNode *tree);
+
 #endif
 
 /* END OF FILE */
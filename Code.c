@@ -1,7 +1,10 @@
-
+#include <limits.h>
 
 #include "Globals.h"
 #include "Code.h"
+#include "Intern.h"
+#include "Util.h"
+#include "TMObject.h"
 
 /* TM location number for current instruction emission */
 static int emitLoc = 0 ;
@@ -11,11 +14,190 @@ static int emitLoc = 0 ;
    emitBackup, and emitRestore */
 static int highEmitLoc = 0;
 
+/* The kinds of line that make up the code */
+typedef enum
+{
+    RegisterK,   /* "op r,s,t"              */
+    MemoryK,     /* "op r,d(s)"             */
+    GotoK,       /* "op r,label(pc)"        */
+    LabelK,      /* a label, as a comment   */
+    CommentK,    /* a comment               */
+    SkippedK,    /* a location not yet backpatched */
+    DeletedK     /* taken out by optimiseCode() */
+} CodeKind;
+
+/* One line of the code, as it will be written out */
+typedef struct
+{
+    unsigned char kind;     /* CodeKind                          */
+    unsigned char op;       /* OpCode                            */
+    signed char   r, s;     /* target and (first) source register */
+    int           d;        /* displacement, or 2nd source reg.  */
+    int           loc;      /* TM location                       */
+    int           comment;  /* index in "comments", or 0 for none */
+    int           label;    /* for gotos and labels              */
+    int           line;     /* the source line it was generated for */
+} CodeLine;
+
+/* A label: where it is, and what it's called */
+typedef struct
+{
+    int  loc;      /* its TM location, or -1 until it's placed */
+    char *name;    /* its interned name, or NULL for "label<n>" */
+} Label;
+
+/* The code emitted so far, in the order it was emitted */
+static CodeLine *lines = NULL;
+static int numLines = 0;
+static int lineCapacity = 0;
+
+/* Which of "lines" each TM location up to highEmitLoc is */
+static int *locLines = NULL;
+static int locCapacity = 0;
+
+/* Comments only get kept when TraceCode is set: entry 0 is never used */
+static char **comments = NULL;
+static int numComments = 0;
+static int commentCapacity = 0;
+
+/* All the labels, numbered from 0 */
+static Label *labels = NULL;
+static int numLabels = 0;
+static int labelCapacity = 0;
+
+/* The named labels, hashed on their names: 0, or 1 + a label */
+static int *namedLabels = NULL;
+static int namedMask = -1;
+static int numNamed = 0;
+
+/* The global variables, for the object file's symbol table */
+static TMSymbol *globals = NULL;
+static char **globalNames = NULL;
+static int numGlobals = 0;
+static int globalCapacity = 0;
+static int globalNameCapacity = 0;
+static int dataSize = 0;
+
+/* The source line that code is being generated for */
+static int sourceLine = 0;
+
+static const char *opNames[] =
+{
+    "HALT", "IN", "OUT", "ADD", "SUB", "MUL", "DIV",
+    "LD", "ST", "LDA", "LDC", "JLT", "JLE", "JGT", "JGE", "JEQ", "JNE"
+};
+
+/* Function keepComment keeps a copy of comment c
+ * if it's going to be written out, and returns
+ * its index in "comments", or 0 if it isn't
+ */
+static int keepComment( char *c)
+{ if (!TraceCode || (c == NULL)) return 0;
+  if (numComments == 0) ++numComments;
+  comments = (char**)growStack(comments, numComments, &commentCapacity,
+                               sizeof(char*));
+  comments[numComments] = copyString(c);
+  return numComments++;
+} /* keepComment */
+
+/* Function newLine adds a line to the end
+ * of the code
+ */
+static CodeLine *newLine( int kind, char *c)
+{ CodeLine *line;
+  int comment = keepComment(c);
+  lines = (CodeLine*)growStack(lines, numLines, &lineCapacity,
+                               sizeof(CodeLine));
+  line = &lines[numLines++];
+  memset(line, 0, sizeof(*line));
+  line->kind = kind;
+  line->loc = emitLoc;
+  line->comment = comment;
+  line->line = sourceLine;
+  return line;
+} /* newLine */
+
+/* Function newInstruction takes the instruction
+ * at the current location: a skipped one is
+ * filled in where it is, any other is added to
+ * the end of the code
+ */
+static CodeLine *newInstruction( int kind, OpCode op, char *c)
+{ CodeLine *line;
+  int loc = emitLoc++;
+  if ((loc < highEmitLoc) && (lines[locLines[loc]].kind == SkippedK))
+  { line = &lines[locLines[loc]];
+    line->kind = kind;
+    line->comment = keepComment(c);
+    line->line = sourceLine;
+  }
+  else
+  { line = newLine(kind, c);
+    locLines = (int*)growStack(locLines, loc, &locCapacity, sizeof(int));
+    locLines[loc] = numLines - 1;
+  }
+  line->op = op;
+  line->loc = loc;
+  if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
+  return line;
+} /* newInstruction */
+
+/* Function findNamed finds the slot of the
+ * hash table that name's label is in, or would
+ * go in
+ */
+static int findNamed( char *name)
+{ int slot = (int)(internHash(name) & namedMask);
+  while ((namedLabels[slot] != 0)
+         && (labels[namedLabels[slot] - 1].name != name))
+    slot = (slot + 1) & namedMask;
+  return slot;
+} /* findNamed */
+
+/* Procedure growNamed doubles the size of the
+ * hash table of named labels
+ */
+static void growNamed(void)
+{ int *oldLabels = namedLabels;
+  int oldSize = namedMask + 1;
+  int i;
+  namedMask = (oldSize == 0) ? 63 : 2 * oldSize - 1;
+  namedLabels = (int*)calloc(namedMask + 1, sizeof(int));
+  if (namedLabels == NULL)
+  { fprintf(listing, "*** Out of memory allocating labels.\n");
+    exit(1);
+  }
+  for (i = 0; i < oldSize; ++i)
+    if (oldLabels[i] != 0)
+      namedLabels[findNamed(labels[oldLabels[i] - 1].name)] = oldLabels[i];
+  free(oldLabels);
+} /* growNamed */
+
+int newLabel(void)
+{ labels = (Label*)growStack(labels, numLabels, &labelCapacity,
+                             sizeof(Label));
+  labels[numLabels].loc = -1;
+  labels[numLabels].name = NULL;
+  return numLabels++;
+} /* newLabel */
+
+int nameLabel(char *name)
+{ int slot;
+  if (2 * (numNamed + 1) > namedMask + 1) growNamed();
+  slot = findNamed(name);
+  if (namedLabels[slot] == 0)
+  { namedLabels[slot] = newLabel() + 1;
+    labels[namedLabels[slot] - 1].name = name;
+    ++numNamed;
+  }
+  return namedLabels[slot] - 1;
+} /* nameLabel */
+
 /* Procedure emitComment prints a comment line 
  * with comment c in the code file
  */
 void emitComment( char * c )
-{ if (TraceCode) fprintf(output,"* %s\n",c);}
+{ if (TraceCode) newLine(CommentK, c);}
 
 /* Procedure emitRO emits a register-only
  * TM instruction
@@ -25,11 +207,16 @@ void emitComment( char * c )
  * t = 2nd source register
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRO( char *op, int r, int s, int t, char *c)
-{ fprintf(output,"%3d:  %5s  %d,%d,%d ",emitLoc++,op,r,s,t);
-  if (TraceCode) fprintf(output,"\t%s",c) ;
-  fprintf(output,"\n") ;
-  if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
+void emitRO( OpCode op, int r, int s, int t, char *c)
+{ CodeLine *line;
+  if (op >= opLD)   /* the TM only reads these as "r,s(t)" */
+  { emitRM(op, r, s, t, c);
+    return;
+  }
+  line = newInstruction(RegisterK, op, c);
+  line->r = r;
+  line->s = s;
+  line->d = t;
 } /* emitRO */
 
 /* Procedure emitRM emits a register-to-memory
@@ -40,34 +227,68 @@ void emitRO( char *op, int r, int s, int t, char *c)
  * s = the base register
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRM( char * op, int r, int d, int s, char *c)
-{ fprintf(output,"%3d:  %5s  %d,%d(%d) ",emitLoc++,op,r,d,s);
-  if (TraceCode) fprintf(output,"\t%s",c) ;
-  fprintf(output,"\n") ;
-  if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc ;
+void emitRM( OpCode op, int r, int d, int s, char *c)
+{ CodeLine *line = newInstruction(MemoryK, op, c);
+  line->r = r;
+  line->d = d;
+  line->s = s;
 } /* emitRM */
-void emitGoto(char *op,int r,char* label,int s,char* c)
-{
-	fprintf(output,"%3d:  %5s  %d,%s(%d) ",emitLoc++,op,r,label,s);
-	if (TraceCode) fprintf(output,"\t%s",c) ;
-	fprintf(output,"\n") ;
-	if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc ;
-}
-void emitLabel(char* label,char* c)
-{
-	fprintf(output,"* %3d :  ${LABEL}: %s",emitLoc,label);
-	if (TraceCode) fprintf(output,"\t%s",c) ;
-	fprintf(output,"\n") ;
-	if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc ;
-}
+/* Procedure emitGoto emits a jump, or a call,
+ * to a label that need not be placed yet
+ * op = the opcode
+ * r = the register tested (or pc, to always go)
+ * label = where to go to
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitGoto( OpCode op, int r, int label, char *c)
+{ CodeLine *line = newInstruction(GotoK, op, c);
+  line->r = r;
+  line->s = pc;
+  line->label = label;
+} /* emitGoto */
+
+/* Procedure emitLabel places label at the
+ * current location
+ */
+void emitLabel( int label, char *c)
+{ CodeLine *line = newLine(LabelK, c);
+  line->label = label;
+  labels[label].loc = emitLoc;
+} /* emitLabel */
+
+/* Procedure emitData reserves "size" words at
+ * "offset" in the data segment for the global
+ * variable "name"
+ */
+void emitData( char *name, int offset, int size)
+{ TMSymbol *symbol;
+  globals = (TMSymbol*)growStack(globals, numGlobals, &globalCapacity,
+                                 sizeof(TMSymbol));
+  globalNames = (char**)growStack(globalNames, numGlobals,
+                                  &globalNameCapacity, sizeof(char*));
+  symbol = &globals[numGlobals];
+  symbol->kind = TMDATASYMBOL;
+  symbol->value = offset;
+  symbol->size = size;
+  symbol->name = 0;
+  globalNames[numGlobals++] = name;
+  if (dataSize < offset + size) dataSize = offset + size;
+} /* emitData */
+
+/* Procedure emitSourceLine notes the source line
+ * that the code emitted next is generated for
+ */
+void emitSourceLine( int line)
+{ sourceLine = line;}
+
 /* Function emitSkip skips "howMany" code
  * locations for later backpatch. It also
  * returns the current code position
  */
 int emitSkip( int howMany)
 {  int i = emitLoc;
-   emitLoc += howMany ;
-   if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc ;
+   while (howMany-- > 0)
+     newInstruction(SkippedK, opHALT, NULL);
    return i;
 } /* emitSkip */
 
@@ -94,11 +315,668 @@ void emitRestore(void)
  * a = the absolute location in memory
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRM_Abs( char *op, int r, int a, char * c)
-{ fprintf(output,"%3d:  %5s  %d,%d(%d) ",
-               emitLoc,op,r,a-(emitLoc+1),pc);
-  ++emitLoc ;
-  if (TraceCode) fprintf(output,"\t%s",c) ;
-  fprintf(output,"\n") ;
-  if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
+void emitRM_Abs( OpCode op, int r, int a, char * c)
+{ emitRM(op, r, a-(emitLoc+1), pc, c);
 } /* emitRM_Abs */
+
+/* Procedure resolveGotos turns every goto into
+ * an ordinary pc-relative jump, complaining
+ * about any label that was never placed
+ */
+static void resolveGotos(void)
+{ CodeLine *line;
+  Label *label;
+  int i;
+  for (i = 0; i < numLines; ++i)
+  { line = &lines[i];
+    if (line->kind != GotoK) continue;
+    label = &labels[line->label];
+    if (label->loc < 0)
+    { if (label->loc == -1)
+      { if (label->name != NULL)
+          fprintf(listing, ">>> Code generation error: \"%s\" is "
+                  "never defined\n", label->name);
+        else
+          fprintf(listing, ">>> Code generation error: label%d is "
+                  "never placed\n", line->label);
+        label->loc = -2;   /* only say so once */
+        Error = TRUE;
+      }
+      continue;
+    }
+    line->kind = MemoryK;
+    line->d = label->loc - (line->loc + 1);
+  }
+} /* resolveGotos */
+
+/* The most instructions isDead() looks through */
+#define MAXDEADSCAN 64
+
+/* The peephole optimiser's view of the code: for
+ * each TM location, its line, whether it's gone,
+ * where it refers to if it's pc-relative (or -1),
+ * and whether any pc-relative line refers to it
+ */
+static CodeLine **code = NULL;
+static unsigned char *deleted = NULL;
+static int *refersTo = NULL;
+static unsigned char *isTarget = NULL;
+static int numCode = 0;
+
+/* Function nextLoc returns the first location
+ * from loc on that hasn't been deleted, or
+ * numCode if there is none
+ */
+static int nextLoc( int loc)
+{ while ((loc < numCode) && deleted[loc]) ++loc;
+  return loc;
+} /* nextLoc */
+
+/* Function isJump tells whether the line at loc
+ * is a jump to a pc-relative location; a
+ * conditional one if "always" is FALSE
+ */
+static int isJump( int loc, int always)
+{ CodeLine *line = code[loc];
+  if ((line->kind != MemoryK) || (line->s != pc)) return FALSE;
+  if ((line->op == opLDA) && (line->r == pc)) return TRUE;
+  return !always && (line->op >= opJLT);
+} /* isJump */
+
+/* Function endsFlow tells whether control never
+ * falls through the line at loc
+ */
+static int endsFlow( int loc)
+{ CodeLine *line = code[loc];
+  if (line->kind == RegisterK) return line->op == opHALT;
+  return (line->kind == MemoryK) && (line->r == pc)
+         && ((line->op == opLDA) || (line->op == opLD));
+} /* endsFlow */
+
+/* Procedure deleteLine takes the line at loc out
+ * of the code
+ */
+static void deleteLine( int loc)
+{ deleted[loc] = TRUE;
+  code[loc]->kind = DeletedK;
+} /* deleteLine */
+
+/* Procedure findTargets marks every location
+ * that a pc-relative line refers to, which a
+ * window may only start at, never span
+ */
+static void findTargets(void)
+{ int loc;
+  memset(isTarget, 0, numCode + 1);
+  for (loc = 0; loc < numCode; ++loc)
+    if (!deleted[loc] && (refersTo[loc] >= 0))
+      isTarget[nextLoc(refersTo[loc])] = TRUE;
+} /* findTargets */
+
+/* Function storeLoad: "ST a,k(b)" then "LD c,k(b)"
+ * loads what's in a already
+ */
+static int storeLoad(void)
+{ CodeLine *st, *ld;
+  int loc, next, hits = 0;
+  for (loc = nextLoc(0); loc < numCode; loc = next)
+  { next = nextLoc(loc + 1);
+    if ((next == numCode) || isTarget[next]) continue;
+    st = code[loc];
+    ld = code[next];
+    if ((st->kind != MemoryK) || (st->op != opST) || (st->s == pc)
+        || (ld->kind != MemoryK) || (ld->op != opLD)
+        || (ld->s != st->s) || (ld->d != st->d)) continue;
+    if (ld->r == st->r) deleteLine(next);
+    else
+    { ld->op = opLDA;   /* a register move */
+      ld->d = 0;
+      ld->s = st->r;
+    }
+    ++hits;
+  }
+  return hits;
+} /* storeLoad */
+
+/* Function loadLoad: "LD a,k(b)" then "LD c,k(b)"
+ * loads what's in a already, if a isn't b
+ */
+static int loadLoad(void)
+{ CodeLine *first, *second;
+  int loc, next, hits = 0;
+  for (loc = nextLoc(0); loc < numCode; loc = next)
+  { next = nextLoc(loc + 1);
+    if ((next == numCode) || isTarget[next]) continue;
+    first = code[loc];
+    second = code[next];
+    if ((first->kind != MemoryK) || (first->op != opLD)
+        || (first->s == pc) || (first->r == first->s) || (first->r == pc)
+        || (second->kind != MemoryK) || (second->op != opLD)
+        || (second->s != first->s) || (second->d != first->d)) continue;
+    if (second->r == first->r) deleteLine(next);
+    else
+    { second->op = opLDA;
+      second->d = 0;
+      second->s = first->r;
+    }
+    ++hits;
+  }
+  return hits;
+} /* loadLoad */
+
+/* Function selfMove: "LDA r,0(r)" does nothing */
+static int selfMove(void)
+{ CodeLine *line;
+  int loc, hits = 0;
+  for (loc = 0; loc < numCode; ++loc)
+  { line = code[loc];
+    if (deleted[loc] || (line->kind != MemoryK) || (line->op != opLDA)
+        || (line->d != 0) || (line->r != line->s) || (line->r == pc))
+      continue;
+    deleteLine(loc);
+    ++hits;
+  }
+  return hits;
+} /* selfMove */
+
+/* Function jumpToNext: a jump to where control
+ * goes anyway does nothing
+ */
+static int jumpToNext(void)
+{ int loc, hits = 0;
+  for (loc = 0; loc < numCode; ++loc)
+    if (!deleted[loc] && isJump(loc, FALSE)
+        && (nextLoc(refersTo[loc]) == nextLoc(loc + 1)))
+    { deleteLine(loc);
+      ++hits;
+    }
+  return hits;
+} /* jumpToNext */
+
+/* Function unreachable: what follows a jump, a
+ * return or a HALT, up to the next location
+ * referred to, can't be reached
+ */
+static int unreachable(void)
+{ int loc, next, hits = 0;
+  for (loc = nextLoc(0); loc < numCode; loc = nextLoc(loc + 1))
+  { if (!endsFlow(loc)) continue;
+    for (next = nextLoc(loc + 1); (next < numCode) && !isTarget[next];
+         next = nextLoc(next + 1))
+    { deleteLine(next);
+      ++hits;
+    }
+  }
+  return hits;
+} /* unreachable */
+
+/* Function reads tells whether the line at loc
+ * reads register reg; writes whether it sets it
+ */
+static int reads( int loc, int reg)
+{ CodeLine *line = code[loc];
+  if (line->kind == RegisterK)
+  { if (line->op == opOUT) return line->r == reg;
+    return (line->op >= opADD) && ((line->s == reg) || (line->d == reg));
+  }
+  if (line->kind != MemoryK) return TRUE;
+  if (line->op == opLDC) return FALSE;
+  if ((line->op == opST) || (line->op >= opJLT))
+    return (line->r == reg) || (line->s == reg);
+  return line->s == reg;
+} /* reads */
+
+static int writes( int loc, int reg)
+{ CodeLine *line = code[loc];
+  if (line->kind == RegisterK)
+    return (line->op != opOUT) && (line->op != opHALT) && (line->r == reg);
+  return (line->kind == MemoryK) && (line->op != opST)
+         && (line->op < opJLT) && (line->r == reg);
+} /* writes */
+
+/* Function deadFrom tells whether register reg is
+ * sure to be set again, from loc on, before it's
+ * next read, on every path control can take.
+ * "budget" is how many more instructions the scan
+ * may look at, shared by the paths of every branch;
+ * when it runs out the answer is no
+ */
+static int deadFrom( int reg, int loc, int *budget)
+{ CodeLine *line;
+  for (; loc < numCode; loc = nextLoc(loc + 1))
+  { if ((--*budget < 0) || reads(loc, reg)) return FALSE;
+    if (writes(loc, reg)) return TRUE;
+    line = code[loc];
+    if (line->kind == SkippedK) return FALSE;
+    if ((line->kind == RegisterK) && (line->op == opHALT)) return TRUE;
+    /* of the temporaries, only ac lives on through a return */
+    if ((line->kind == MemoryK) && (line->op == opLD) && (line->r == pc))
+      return (reg != ac) && (reg < gp);
+    if (isJump(loc, TRUE))
+      loc = nextLoc(refersTo[loc]) - 1;
+    else if (isJump(loc, FALSE))
+    { if (!deadFrom(reg, nextLoc(refersTo[loc]), budget)) return FALSE;
+    }
+    else if (line->r == pc) return FALSE;
+  }
+  return FALSE;
+} /* deadFrom */
+
+/* Function isDead tells whether register reg is
+ * sure to be set again after loc before it's
+ * next read, looking at most MAXDEADSCAN
+ * instructions ahead
+ */
+static int isDead( int reg, int loc)
+{ int budget = MAXDEADSCAN;
+  return deadFrom(reg, nextLoc(loc + 1), &budget);
+} /* isDead */
+
+/* Function addressedStore: "LDA a,k(b)" then
+ * "ST c,0(a)" is "ST c,k(b)", if that's the last
+ * use of a
+ */
+static int addressedStore(void)
+{ CodeLine *lda, *st;
+  int loc, next, hits = 0;
+  for (loc = nextLoc(0); loc < numCode; loc = next)
+  { next = nextLoc(loc + 1);
+    if ((next == numCode) || isTarget[next]) continue;
+    lda = code[loc];
+    st = code[next];
+    if ((lda->kind != MemoryK) || (lda->op != opLDA) || (lda->r == pc)
+        || (lda->r == lda->s) || (lda->s == pc)
+        || (st->kind != MemoryK) || (st->op != opST) || (st->s != lda->r)
+        || (st->d != 0) || (st->r == lda->r) || !isDead(lda->r, next))
+      continue;
+    st->d = lda->d;
+    st->s = lda->s;
+    deleteLine(loc);
+    ++hits;
+  }
+  return hits;
+} /* addressedStore */
+
+/* Function constantOperand: "LDC a,v" then
+ * "ADD c,b,a" (or "ADD c,a,b") is "LDA c,v(b)",
+ * and "SUB c,b,a" is "LDA c,-v(b)", if that's
+ * the last use of a
+ */
+static int constantOperand(void)
+{ CodeLine *ldc, *op;
+  int loc, next, other, hits = 0;
+  for (loc = nextLoc(0); loc < numCode; loc = next)
+  { next = nextLoc(loc + 1);
+    if ((next == numCode) || isTarget[next]) continue;
+    ldc = code[loc];
+    op = code[next];
+    if ((ldc->kind != MemoryK) || (ldc->op != opLDC) || (ldc->r == pc)
+        || (op->kind != RegisterK)) continue;
+    if ((op->op == opADD) && (op->d == ldc->r)) other = op->s;
+    else if ((op->op == opADD) && (op->s == ldc->r)) other = op->d;
+    else if ((op->op == opSUB) && (op->d == ldc->r) && (ldc->d != INT_MIN))
+      other = op->s;
+    else continue;
+    if ((other == ldc->r) || ((op->r != ldc->r) && !isDead(ldc->r, next)))
+      continue;
+    op->kind = MemoryK;
+    op->d = (op->op == opSUB) ? -ldc->d : ldc->d;
+    op->op = opLDA;
+    op->s = other;
+    deleteLine(loc);
+    ++hits;
+  }
+  return hits;
+} /* constantOperand */
+
+/* Function knownConstant: "LDC r,v" when r is
+ * already known to hold v, from an earlier LDC
+ * in the same straight-line stretch of code
+ */
+static int knownConstant(void)
+{ int known[pc + 1], value[pc + 1];
+  CodeLine *line;
+  int loc, r, hits = 0;
+  for (r = 0; r <= pc; ++r) known[r] = FALSE;
+  for (loc = nextLoc(0); loc < numCode; loc = nextLoc(loc + 1))
+  { line = code[loc];
+    if (isTarget[loc])
+      for (r = 0; r <= pc; ++r) known[r] = FALSE;
+    if ((line->kind == MemoryK) && (line->op == opLDC))
+    { if (known[line->r] && (value[line->r] == line->d))
+      { deleteLine(loc);
+        ++hits;
+        continue;
+      }
+      known[line->r] = TRUE;
+      value[line->r] = line->d;
+    }
+    else if ((line->kind == RegisterK) && (line->op != opOUT))
+      known[line->r] = FALSE;
+    else if ((line->kind == MemoryK) && (line->op != opST)
+             && (line->op < opJLT))
+      known[line->r] = FALSE;
+    else if (line->kind == SkippedK)
+      for (r = 0; r <= pc; ++r) known[r] = FALSE;
+  }
+  return hits;
+} /* knownConstant */
+
+/* Function jumpToJump: a jump to an unconditional
+ * jump may as well go where that one goes
+ */
+static int jumpToJump(void)
+{ int loc, to, hits = 0;
+  for (loc = 0; loc < numCode; ++loc)
+  { if (deleted[loc] || !isJump(loc, FALSE)) continue;
+    to = nextLoc(refersTo[loc]);
+    if ((to == numCode) || (to == loc) || !isJump(to, TRUE)
+        || (nextLoc(refersTo[to]) == to)) continue;
+    refersTo[loc] = refersTo[to];
+    ++hits;
+  }
+  return hits;
+} /* jumpToJump */
+
+/* The rules, in the order they're tried, and the
+ * -O level each needs; each one returns how many
+ * times it changed the code
+ */
+typedef struct
+{
+  char *name;
+  int level;
+  int (*apply)(void);
+  int hits;
+} PeepholeRule;
+
+static PeepholeRule rules[] =
+{
+  { "store then load",   1, storeLoad,     0 },
+  { "load then load",    1, loadLoad,      0 },
+  { "move to itself",    1, selfMove,      0 },
+  { "addressed store",   1, addressedStore, 0 },
+  { "constant operand",  1, constantOperand, 0 },
+  { "jump to next",      1, jumpToNext,    0 },
+  { "unreachable",       1, unreachable,   0 },
+  { "known constant",    2, knownConstant, 0 },
+  { "jump to jump",      2, jumpToJump,    0 }
+};
+
+#define NUMRULES ((int)(sizeof(rules) / sizeof(rules[0])))
+
+/* No chain of jumps to jumps is threaded further than this */
+#define MAXPEEPHOLEPASSES 16
+
+/* Procedure relocate gives the lines that are
+ * left their new locations, and their pc-relative
+ * displacements to match
+ */
+static void relocate(void)
+{ int *newLocs = (int*)malloc((numCode + 1) * sizeof(int));
+  CodeLine *line;
+  int i, loc, count = 0;
+  if (newLocs == NULL)
+  { fprintf(listing, "*** Out of memory optimising the code.\n");
+    exit(1);
+  }
+  for (loc = 0; loc < numCode; ++loc)
+    newLocs[loc] = deleted[loc] ? -1 : count++;
+  newLocs[numCode] = count;
+  for (loc = numCode - 1; loc >= 0; --loc)   /* gone: where control goes */
+    if (newLocs[loc] < 0) newLocs[loc] = newLocs[loc + 1];
+  for (loc = 0; loc < numCode; ++loc)
+  { if (deleted[loc]) continue;
+    if (refersTo[loc] >= 0)
+      code[loc]->d = newLocs[refersTo[loc]] - (newLocs[loc] + 1);
+    locLines[newLocs[loc]] = locLines[loc];
+  }
+  for (i = 0; i < numLines; ++i)
+  { line = &lines[i];
+    if (line->kind != DeletedK)
+      line->loc = newLocs[(line->loc < numCode) ? line->loc : numCode];
+  }
+  for (i = 0; i < numLabels; ++i)
+    if (labels[i].loc >= 0)
+      labels[i].loc = newLocs[(labels[i].loc < numCode) ? labels[i].loc
+                              : numCode];
+  emitLoc = highEmitLoc = count;
+  free(newLocs);
+} /* relocate */
+
+/* Procedure optimiseCode slides the peephole
+ * rules of this level over the code, until
+ * none of them finds any more to do
+ */
+void optimiseCode( int level)
+{ int loc, i, passes, changed, hits;
+  resolveGotos();
+  if (Error) return;
+  numCode = highEmitLoc;
+  code = (CodeLine**)malloc((numCode + 1) * sizeof(CodeLine*));
+  deleted = (unsigned char*)calloc(numCode + 1, 1);
+  refersTo = (int*)malloc((numCode + 1) * sizeof(int));
+  isTarget = (unsigned char*)calloc(numCode + 1, 1);
+  if ((code == NULL) || (deleted == NULL) || (refersTo == NULL)
+      || (isTarget == NULL))
+  { fprintf(listing, "*** Out of memory optimising the code.\n");
+    exit(1);
+  }
+  /* pc-relative displacements become absolute while lines move */
+  for (loc = 0; loc < numCode; ++loc)
+  { code[loc] = &lines[locLines[loc]];
+    refersTo[loc] = -1;
+    if ((code[loc]->kind != MemoryK) || (code[loc]->s != pc)) continue;
+    refersTo[loc] = loc + 1 + code[loc]->d;
+    if ((refersTo[loc] < 0) || (refersTo[loc] > numCode))
+      break;   /* it refers outside the code: leave the code be */
+  }
+  for (i = 0; i < NUMRULES; ++i) rules[i].hits = 0;
+  for (passes = 0; (loc == numCode) && (passes < MAXPEEPHOLEPASSES);
+       ++passes)
+  { changed = 0;
+    for (i = 0; i < NUMRULES; ++i)
+      if (rules[i].level <= level)
+      { findTargets();
+        hits = rules[i].apply();
+        rules[i].hits += hits;
+        changed += hits;
+      }
+    if (!changed) break;
+  }
+  if (loc == numCode) relocate();
+  if (TraceCode)
+    for (i = 0; i < NUMRULES; ++i)
+      if (rules[i].level <= level)
+        fprintf(listing, "*** Peephole rule \"%s\": %d hits\n",
+                rules[i].name, rules[i].hits);
+  free(code);
+  free(deleted);
+  free(refersTo);
+  free(isTarget);
+  code = NULL;
+  deleted = isTarget = NULL;
+  refersTo = NULL;
+  numCode = 0;
+} /* optimiseCode */
+
+/* Procedure releaseCode forgets all the code,
+ * labels and globals, ready for the next program
+ */
+static void releaseCode(void)
+{ free(lines);
+  free(locLines);
+  free(comments);
+  free(labels);
+  free(namedLabels);
+  lines = NULL;
+  locLines = NULL;
+  comments = NULL;
+  labels = NULL;
+  namedLabels = NULL;
+  numLines = lineCapacity = locCapacity = 0;
+  numComments = commentCapacity = 0;
+  numLabels = labelCapacity = numNamed = 0;
+  namedMask = -1;
+  free(globals);
+  free(globalNames);
+  globals = NULL;
+  globalNames = NULL;
+  numGlobals = globalCapacity = globalNameCapacity = dataSize = 0;
+  emitLoc = highEmitLoc = sourceLine = 0;
+} /* releaseCode */
+
+/* Procedure writeCode formats every line into
+ * one buffer, which goes out in a single write;
+ * skipped locations never backpatched are left
+ * out, as they always were
+ */
+void writeCode( FILE *file)
+{ char *text;
+  size_t length = 0, capacity = 0;
+  CodeLine *line;
+  char *c;
+  int i;
+  resolveGotos();
+  for (i = 0; i < numLines; ++i)
+  { capacity += 64;
+    if ((lines[i].kind == LabelK) && (labels[lines[i].label].name != NULL))
+      capacity += strlen(labels[lines[i].label].name);
+    if (lines[i].comment != 0) capacity += strlen(comments[lines[i].comment]);
+  }
+  text = (char*)malloc(capacity + 1);
+  if (text == NULL)
+  { fprintf(listing, "*** Out of memory writing the code.\n");
+    exit(1);
+  }
+  for (i = 0; i < numLines; ++i)
+  { line = &lines[i];
+    c = (line->comment != 0) ? comments[line->comment] : NULL;
+    switch (line->kind)
+    { case RegisterK:
+        length += sprintf(text + length, "%3d:  %5s  %d,%d,%d ",
+                          line->loc, opNames[line->op], line->r, line->s, line->d);
+        break;
+      case MemoryK:
+        length += sprintf(text + length, "%3d:  %5s  %d,%d(%d) ",
+                          line->loc, opNames[line->op], line->r, line->d, line->s);
+        break;
+      case LabelK:
+        if (labels[line->label].name != NULL)
+          length += sprintf(text + length, "* %3d :  %s:",
+                            line->loc, labels[line->label].name);
+        else
+          length += sprintf(text + length, "* %3d :  label%d:",
+                            line->loc, line->label);
+        break;
+      case CommentK:
+        length += sprintf(text + length, "* %s\n", c);
+        continue;
+      default:   /* unresolved gotos, and skipped locations */
+        continue;
+    }
+    if (TraceCode) length += sprintf(text + length, "\t%s", c ? c : "(null)");
+    text[length++] = '\n';
+  }
+  if (fwrite(text, 1, length, file) != length)
+    fprintf(listing, "*** Could not write all of the code.\n");
+  free(text);
+  releaseCode();
+} /* writeCode */
+
+/* Procedure writeObject writes all the code
+ * emitted so far to "file" as a binary object
+ * (see TMObject.h), in a single write, then
+ * forgets it; withTables adds the symbol and
+ * line tables
+ */
+void writeObject( FILE *file, int withTables)
+{ TMObjectHeader header;
+  TMInstruction *code;
+  TMSymbol *symbols;
+  TMLine *lineTable;
+  char *object, *strings, *name;
+  size_t size;
+  CodeLine *line;
+  int i, numSymbols = 0, numLineRuns = 0, stringSize = 0, lastLine = -1;
+  resolveGotos();
+  if (withTables)
+  { for (i = 0; i < numLabels; ++i)
+      if ((labels[i].name != NULL) && (labels[i].loc >= 0))
+      { ++numSymbols;
+        stringSize += strlen(labels[i].name) + 1;
+      }
+    for (i = 0; i < numGlobals; ++i)
+      stringSize += strlen(globalNames[i]) + 1;
+    numSymbols += numGlobals;
+    for (i = 0; i < highEmitLoc; ++i)
+      if (lines[locLines[i]].line != lastLine)
+      { lastLine = lines[locLines[i]].line;
+        ++numLineRuns;
+      }
+    stringSize = (stringSize + 3) & ~3;
+  }
+  memset(&header, 0, sizeof(header));
+  header.magic = TMOBJECT_MAGIC;
+  header.version = TMOBJECT_VERSION;
+  header.flags = withTables ? (TMOBJECT_SYMBOLS | TMOBJECT_LINES) : 0;
+  header.numInstructions = highEmitLoc;
+  header.dataSize = dataSize;
+  header.numSymbols = numSymbols;
+  header.numLines = numLineRuns;
+  header.stringSize = stringSize;
+  size = sizeof(header) + highEmitLoc * sizeof(TMInstruction)
+         + dataSize * sizeof(int) + numSymbols * sizeof(TMSymbol)
+         + numLineRuns * sizeof(TMLine) + stringSize;
+  object = (char*)calloc(size, 1);
+  if (object == NULL)
+  { fprintf(listing, "*** Out of memory writing the code.\n");
+    exit(1);
+  }
+  memcpy(object, &header, sizeof(header));
+  /* never-emitted locations are left as HALT 0,0,0, as the TM has them */
+  code = (TMInstruction*)(object + sizeof(header));
+  for (i = 0; i < numLines; ++i)
+  { line = &lines[i];
+    if ((line->kind != RegisterK) && (line->kind != MemoryK)) continue;
+    code[line->loc].op = line->op;
+    code[line->loc].r = line->r;
+    code[line->loc].s = line->s;
+    code[line->loc].d = line->d;
+  }
+  /* the data segment starts out all zeroes */
+  symbols = (TMSymbol*)((int*)(code + highEmitLoc) + dataSize);
+  lineTable = (TMLine*)(symbols + numSymbols);
+  strings = (char*)(lineTable + numLineRuns);
+  if (withTables)
+  { name = strings;
+    for (i = 0; i < numLabels; ++i)
+      if ((labels[i].name != NULL) && (labels[i].loc >= 0))
+      { symbols->kind = TMCODESYMBOL;
+        symbols->value = labels[i].loc;
+        symbols->name = (int)(name - strings);
+        strcpy(name, labels[i].name);
+        name += strlen(name) + 1;
+        ++symbols;
+      }
+    for (i = 0; i < numGlobals; ++i)
+    { *symbols = globals[i];
+      symbols->name = (int)(name - strings);
+      strcpy(name, globalNames[i]);
+      name += strlen(name) + 1;
+      ++symbols;
+    }
+    lastLine = -1;
+    for (i = 0; i < highEmitLoc; ++i)
+      if (lines[locLines[i]].line != lastLine)
+      { lastLine = lines[locLines[i]].line;
+        lineTable->loc = i;
+        lineTable->line = lastLine;
+        ++lineTable;
+      }
+  }
+  if (fwrite(object, 1, size, file) != size)
+    fprintf(listing, "*** Could not write all of the code.\n");
+  free(object);
+  releaseCode();
+} /* writeObject */
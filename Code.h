@@ -3,6 +3,8 @@
 #ifndef _CODE_H_
 #define _CODE_H_
 
+#include <stdio.h>
+
 
 /* pc = program counter  */
 #define  pc 7
@@ -28,8 +30,22 @@
 #define ofpFO 0
 #define retFO -1
 #define initFO -2
+
+/* The TM's opcodes.  The register-only ones come first. */
+typedef enum
+{
+    opHALT, opIN, opOUT, opADD, opSUB, opMUL, opDIV,
+    opLD, opST, opLDA, opLDC, opJLT, opJLE, opJGT, opJGE, opJEQ, opJNE
+} OpCode;
+
 /* code emitting utilities */
 
+/*
+ * The code isn't written out as it's emitted: it's kept in memory, where
+ * skipped locations can be backpatched, until writeCode() writes the
+ * whole program out in one go.
+ */
+
 /* Procedure emitComment prints a comment line 
  * with comment c in the code file
  */
@@ -37,13 +53,14 @@ void emitComment( char * c );
 
 /* Procedure emitRO emits a register-only
  * TM instruction
- * op = the opcode
+ * op = the opcode (a register-memory one is
+ *      written as "r,s(t)", as the TM reads it)
  * r = target register
  * s = 1st source register
  * t = 2nd source register
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRO( char *op, int r, int s, int t, char *c);
+void emitRO( OpCode op, int r, int s, int t, char *c);
 
 /* Procedure emitRM emits a register-to-memory
  * TM instruction
@@ -53,7 +70,7 @@ void emitRO( char *op, int r, int s, int t, char *c);
  * s = the base register
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRM( char * op, int r, int d, int s, char *c);
+void emitRM( OpCode op, int r, int d, int s, char *c);
 
 /* Function emitSkip skips "howMany" code
  * locations for later backpatch. It also
@@ -72,9 +89,32 @@ void emitBackup( int loc);
  */
 void emitRestore(void);
 
-void emitLabel(char* label,char* c);
+/* Function newLabel returns a new label, with
+ * no name and no location yet
+ */
+int newLabel(void);
 
-void emitGoto(char *op,int r,char* label,int s,char* c);
+/* Function nameLabel returns the label named by
+ * the interned name (see Intern.h), making it
+ * the first time the name is asked for
+ */
+int nameLabel(char *name);
+
+/* Procedure emitLabel puts label at the current
+ * code location
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitLabel( int label, char *c);
+
+/* Procedure emitGoto emits a register-to-memory
+ * TM instruction whose target is label, wherever
+ * that turns out to be: writeCode() fills in
+ * its pc-relative displacement
+ * op = the opcode
+ * r = target register
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitGoto( OpCode op, int r, int label, char *c);
 
 
 
@@ -86,6 +126,40 @@ void emitGoto(char *op,int r,char* label,int s,char* c);
  * a = the absolute location in memory
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRM_Abs( char *op, int r, int a, char * c);
+void emitRM_Abs( OpCode op, int r, int a, char * c);
+
+/* Procedure optimiseCode runs the peephole
+ * optimiser over all the code emitted so far,
+ * with the rules that "level" (the -O level)
+ * asks for, and reports their hits in the
+ * listing if TraceCode is TRUE
+ */
+void optimiseCode( int level);
+
+/* Procedure writeCode writes all the code
+ * emitted so far to "file" in a single write,
+ * with every goto resolved, then forgets it;
+ * a label that was never placed is an error
+ */
+void writeCode( FILE *file);
+
+/* Procedure emitData reserves "size" words at
+ * "offset" in the data segment for the global
+ * variable "name" (an interned name)
+ */
+void emitData( char *name, int offset, int size);
+
+/* Procedure emitSourceLine notes the source line
+ * that the code emitted next is generated for
+ */
+void emitSourceLine( int line);
+
+/* Procedure writeObject writes all the code
+ * emitted so far to "file" as a binary object
+ * (see TMObject.h) in a single write, then
+ * forgets it; withTables adds the symbol and
+ * line tables
+ */
+void writeObject( FILE *file, int withTables);
 
 #endif
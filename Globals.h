@@ -16,7 +16,8 @@
 "Parts borrowed from K. J. Louden\'s Tiny C Compiler.\n"
 
 #define USAGE \
-"\nUsage:  compiler [-s|-l|-y|-a|-c] -f <file>\n"\
+"\nUsage:  compiler [-s|-l|-y|-a|-c|-t|-b|-g] [-j <threads>] [-p <threads>] [-d <depth>]\n"\
+"                 [-O <level>] -f <file>\n"\
 "\n"\
 "The following are valid command-line options:\n"\
 "\n"\
@@ -25,8 +26,18 @@
 "  -y    Show parser debug output in source listing.\n"\
 "  -a    Show semantic analyser output in source listing.\n"\
 "  -c    Show code generation output in source listing.\n"\
+"  -t    Scan the whole source into a token array before parsing.\n"\
+"  -b    Write a binary TM object (.tmo) instead of textual code (.tm).\n"\
+"  -g    Include symbol and line tables in a binary object (implies -b).\n"\
 "\n"\
-"  -f <filename>     Specify the source file to compile.\n"
+"  -f <filename>     Specify the source file to compile.\n"\
+"  -j <threads>      Scan large source files on this many threads (implies -t).\n"\
+"  -p <threads>      Check large programs' functions on this many threads.\n"\
+"  -d <depth>        Reject statements nested, or expression trees, deeper\n"\
+"                    than this.\n"\
+"  -O <level>        Optimise the code: 1 for peephole rules, tail calls and\n"\
+"                    inlining tiny functions, 2 for all of the rules and\n"\
+"                    inlining bigger functions.\n"
 
 
 /* Includes that are used everywhere */
@@ -37,6 +48,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "Thread.h"
+
 #define DEBUG 1
 /* Redefine FALSE and TRUE */
 
@@ -85,7 +98,15 @@ typedef enum
  */
 
 typedef enum {ErrorK, StmtK, ExpK, DecK } NodeKind;
-typedef enum {SErrorK, IfK, WhileK, ReturnK, CallK, CompoundK } StmtKind;
+
+/*
+ * An InlineK statement is a call that the inliner has replaced with a copy
+ *  of the function's body (see inlineCalls()).  Like a compound statement,
+ *  child[0] declares its variables: copies of the parameters that need
+ *  them.  child[1] assigns them the arguments, then runs the body.
+ */
+typedef enum {SErrorK, IfK, WhileK, ReturnK, CallK, CompoundK, InlineK } StmtKind;
+
 typedef enum {EErrorK, OpK, IdK, ConstK, AssignK } ExpKind;
 typedef enum {DErrorK, ScalarDecK, ArrayDecK, FuncDecK } DecKind;
 
@@ -94,56 +115,48 @@ typedef enum { TypeError,Void, Integer, Boolean, Array, Function } ExpType;
 
 #define MAXCHILDREN  3
 
-typedef struct treeNode
-{
-    struct treeNode *child[MAXCHILDREN];
-    struct treeNode *sibling;
-    int             lineno;
+/*
+ * Syntax tree nodes live in the node pool (see Util.h), and refer to one
+ *  another by NodeIndex, their 32-bit index in the pool, rather than by
+ *  pointer.  Index 0 is never used, and means "no node".  NODE() turns an
+ *  index into a pointer, and nodeIndex() does the reverse.
+ */
 
-    NodeKind        nodekind;  /* the type of the AST node */
+typedef unsigned int NodeIndex;
 
-    union
-    {
-        StmtKind        stmt;
-        ExpKind         exp;
-        DecKind         dec;
-    } kind;
-
-    TokenType  op;
-    int        val;
-    char       *name;
+/*
+ * Attributes that only declarations need are kept out of the tree nodes,
+ *  in a side table of DecInfo entries; DECINFO() finds a node's entry.
+ *  Nodes that aren't declarations all share entry 0, which reads as zero.
+ */
 
+typedef struct
+{
     /*
      * If the node is a function definition, this holds the function's
-     *  return type.
+     *  return type (an ExpType).
      */
-    ExpType    functionReturnType;
+    unsigned char functionReturnType;
 
     /*
      *  If the node is a variable, then we need to record the data type.
      */
-    ExpType    variableDataType;
-
-    /*
-     * The following is used in the type checking of expressions
-     */
-    ExpType         expressionType;
+    unsigned char variableDataType;
 
     /*
      * If isParameter is TRUE, then this node declares an actual parameter
      *   to a function.
      */
-    int isParameter;
+    unsigned char isParameter;
 
     /* If isGlobal is TRUE, then the variable is a global */
-    int isGlobal;
+    unsigned char isGlobal;
 
     /*
-     * (bjf, 7/5/2000) The following is used in the semantic analyser to
-     *  allow the code generator to locate type information for a given
-     *  identifier.
+     * If isReachable is TRUE, then the function can be called, or the
+     *  global used, by code reachable from main() (see markReachable()).
      */
-    struct treeNode *declaration;
+    unsigned char isReachable;
 
     /*
      * (bjf, 21/5/2000) Added a pair of attributes needed to generate
@@ -163,6 +176,49 @@ typedef struct treeNode
      */
     int offset;
 
+} DecInfo;
+
+typedef struct treeNode
+{
+    /*
+     * The fields that every walk of the tree looks at come first, packed
+     *  into the same few words.  The kinds and types are the enums above,
+     *  held in a byte each.
+     */
+    unsigned char   nodekind;  /* the type of the AST node (NodeKind) */
+
+    union
+    {
+        unsigned char   stmt;  /* StmtKind */
+        unsigned char   exp;   /* ExpKind  */
+        unsigned char   dec;   /* DecKind  */
+    } kind;
+
+    unsigned char   op;        /* TokenType */
+
+    /*
+     * The following is used in the type checking of expressions
+     */
+    unsigned char   expressionType;
+
+    NodeIndex       child[MAXCHILDREN];
+    NodeIndex       sibling;
+
+    NodeIndex       index;     /* the node's own index in the pool */
+    int             lineno;
+    int             val;
+    char            *name;     /* interned: compare by address (see Intern.h) */
+
+    /*
+     * (bjf, 7/5/2000) The following is used in the semantic analyser to
+     *  allow the code generator to locate type information for a given
+     *  identifier.
+     */
+    NodeIndex       declaration;
+
+    /* for declarations, the index of their DecInfo entry; otherwise 0 */
+    unsigned int    decInfo;
+
 } TreeNode;
 
 
@@ -171,7 +227,7 @@ typedef struct treeNode
  **********************************************************************/
 
 extern FILE* source;    /* Input source file           */
-extern FILE* listing;   /* Listing output              */
+extern THREADLOCAL FILE* listing;   /* Listing output, one per thread */
 extern FILE* output;      /* Output file of the compiler */
 
 extern int lineno;      /* The current line number of the source file */
@@ -193,6 +249,40 @@ extern int EchoSource;
 
 extern int TraceScan;
 
+
+/*
+ * PreLexTokens - if set to TRUE, the whole source file is scanned into
+ *  the token buffer before parsing starts, instead of a token at a time.
+ */
+
+extern int PreLexTokens;
+
+
+/*
+ * ScanThreads - the number of threads that a large source file may be
+ *  scanned on when PreLexTokens is set.
+ */
+
+extern int ScanThreads;
+
+
+/*
+ * AnalyseThreads - the number of threads that the functions of a large
+ *  program may be type checked and laid out on.
+ */
+
+extern int AnalyseThreads;
+
+
+/*
+ * NestingLimit - how deeply statements may nest, and separately how many
+ *  levels deep an expression's tree may be (brackets, subscripts,
+ *  arguments, assignments and each operator of a chain all count), before
+ *  the parser gives up on them with an error.
+ */
+
+extern int NestingLimit;
+
 /* TraceParse: get a parse tree displayed in the listing file */
 extern int TraceParse;
 
@@ -201,13 +291,39 @@ extern int TraceAnalyse;
 
 /*
  * Error - if set to TRUE, prevents execution of subsequent passes if an
- *  error occurs.
+ *  error occurs.  Like the listing file, each thread has its own.
  */
 
-extern int Error;
+extern THREADLOCAL int Error;
 
 
 extern int TraceCode;
+
+
+/*
+ * BinaryObject - if set to TRUE, the code is written as a binary TM
+ *  object (see TMObject.h) rather than as TM assembly text.
+ */
+
+extern int BinaryObject;
+
+
+/*
+ * ObjectTables - if set to TRUE, a binary TM object also gets a symbol
+ *  table and a source line table.
+ */
+
+extern int ObjectTables;
+
+
+/*
+ * OptimiseLevel - how hard to optimise the generated code: 0 not at all,
+ *  1 or more for the peephole optimiser's rules of that level and below,
+ *  for inlining functions within that level's size budget, and for
+ *  making calls in tail position reuse the caller's frame.
+ */
+
+extern int OptimiseLevel;
 #endif
 
 /* END OF FILE */
@@ -0,0 +1,176 @@
+
+
+#include <stddef.h>
+
+#include "Globals.h"
+#include "Arena.h"
+#include "Intern.h"
+
+
+/*
+ * The intern table is an open hash table whose bucket array doubles in
+ *  size whenever the number of names exceeds the number of buckets, so the
+ *  chains stay short however many identifiers a program uses.
+ */
+
+#define INITIALBUCKETS 1024
+
+/* FNV-1a parameters (32-bit) */
+#define FNVOFFSETBASIS 2166136261u
+#define FNVPRIME       16777619u
+
+typedef struct internEntry
+{
+    struct internEntry *next;     /* next entry on this bucket chain */
+    unsigned int       hash;      /* hash of the spelling            */
+    int                length;    /* length of the spelling          */
+    char               name[1];   /* the spelling, null-terminated   */
+} InternEntry;
+
+
+static InternEntry **buckets = NULL;   /* the bucket array           */
+static unsigned int numBuckets = 0;    /* size of the bucket array   */
+static unsigned int numNames = 0;      /* number of distinct names   */
+
+/* Statistics reported by printInternStatistics() */
+static unsigned long internHits = 0;
+static unsigned long internMisses = 0;
+
+
+/* Function prototypes for module statics */
+
+static unsigned int hashText(const char *text, int length);
+static void growTable(void);
+
+
+char *internString(const char *text, int length)
+{
+    unsigned int hash;
+    InternEntry  *entry;
+    InternEntry  **bucket;
+
+    if (buckets == NULL)
+        growTable();
+
+    hash = hashText(text, length);
+    bucket = &buckets[hash & (numBuckets - 1)];
+
+    for (entry = *bucket; entry != NULL; entry = entry->next)
+    {
+        if ((entry->hash == hash) && (entry->length == length)
+                && (memcmp(entry->name, text, length) == 0))
+        {
+            ++internHits;
+            return entry->name;
+        }
+    }
+
+    /* first sighting of this name: add it to the front of the chain */
+    ++internMisses;
+
+    entry = (InternEntry*)arenaAlloc(sizeof(InternEntry) + length);
+    if (entry == NULL)
+    {
+        fprintf(listing, "*** Out of memory at line %d.\n", lineno);
+        exit(1);
+    }
+
+    entry->hash = hash;
+    entry->length = length;
+    memcpy(entry->name, text, length);
+    entry->name[length] = '\0';
+
+    entry->next = *bucket;
+    *bucket = entry;
+
+    if (++numNames > numBuckets)
+        growTable();
+
+    return entry->name;
+}
+
+
+char *internName(const char *name)
+{
+    return internString(name, (int)strlen(name));
+}
+
+
+unsigned int internHash(const char *symbol)
+{
+    const InternEntry *entry;
+
+    entry = (const InternEntry*)(symbol - offsetof(InternEntry, name));
+    return entry->hash;
+}
+
+
+void releaseInternTable(void)
+{
+    /* the entries themselves belong to the arena */
+    free(buckets);
+    buckets = NULL;
+    numBuckets = numNames = 0;
+}
+
+
+void printInternStatistics(void)
+{
+    fprintf(listing, "*** Identifier table: %lu lookups, %lu hits, "
+            "%lu misses, %u buckets\n",
+            internHits + internMisses, internHits, internMisses,
+            numBuckets);
+}
+
+
+/* FNV-1a hash of a piece of text */
+static unsigned int hashText(const char *text, int length)
+{
+    unsigned int hash = FNVOFFSETBASIS;
+    int          i;
+
+    for (i = 0; i < length; ++i)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= FNVPRIME;
+    }
+
+    return hash;
+}
+
+
+/* Allocates the bucket array, or doubles it and rehashes every entry */
+static void growTable(void)
+{
+    InternEntry  **newBuckets;
+    InternEntry  *entry;
+    InternEntry  *next;
+    unsigned int newSize;
+    unsigned int i;
+
+    newSize = (numBuckets == 0) ? INITIALBUCKETS : numBuckets * 2;
+
+    newBuckets = (InternEntry**)calloc(newSize, sizeof(InternEntry*));
+    if (newBuckets == NULL)
+    {
+        fprintf(listing, "*** Out of memory at line %d.\n", lineno);
+        exit(1);
+    }
+
+    for (i = 0; i < numBuckets; ++i)
+    {
+        for (entry = buckets[i]; entry != NULL; entry = next)
+        {
+            next = entry->next;
+            entry->next = newBuckets[entry->hash & (newSize - 1)];
+            newBuckets[entry->hash & (newSize - 1)] = entry;
+        }
+    }
+
+    free(buckets);
+    buckets = newBuckets;
+    numBuckets = newSize;
+}
+
+
+/* END OF FILE */
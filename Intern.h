@@ -0,0 +1,64 @@
+
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "Globals.h"
+
+/*
+ * Identifiers are interned: every spelling is stored exactly once, and
+ *  the pointer to that copy serves as the identifier's handle.  Two
+ *  interned names are the same identifier if and only if the pointers are
+ *  equal, so they can be compared with "==" rather than strcmp().  The
+ *  handle is an ordinary null-terminated string, so it can still be
+ *  printed directly.  Handles stay valid until the compilation arena is
+ *  released (see Arena.h).
+ */
+
+
+/*
+ * NAME:     internString()
+ * PURPOSE:  Returns the interned handle for the "length" characters at
+ *            "text", adding them to the table if they're not already
+ *            there.
+ */
+
+char *internString(const char *text, int length);
+
+
+/*
+ * NAME:     internName()
+ * PURPOSE:  Returns the interned handle for a null-terminated string.
+ */
+
+char *internName(const char *name);
+
+
+/*
+ * NAME:     internHash()
+ * PURPOSE:  Returns the hash value computed when a handle was interned.
+ *            "symbol" must have come from internString() or internName().
+ */
+
+unsigned int internHash(const char *symbol);
+
+
+/*
+ * NAME:     releaseInternTable()
+ * PURPOSE:  Empties the intern table.  The names themselves are allocated
+ *            from the compilation arena, so they go with releaseArena().
+ */
+
+void releaseInternTable(void);
+
+
+/*
+ * NAME:     printInternStatistics()
+ * PURPOSE:  Reports intern table lookups, hits and misses to the listing.
+ */
+
+void printInternStatistics(void);
+
+#endif
+
+/* END OF FILE */
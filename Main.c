@@ -3,7 +3,11 @@
 #include "getopt.h"
 
 #include "Globals.h"
+#include "Arena.h"
+#include "Intern.h"
 #include "Util.h"
+#include "Scan.h"
+#include "TMObject.h"
 
 /*
  * We will use conditional compilation in the same style of Louden's
@@ -27,16 +31,17 @@
 
 #if NO_PARSE
 #define BUILDTYPE "SCANNER ONLY"
-#include "Scan.h"   /* Test the scanner only */
 #else
 #include "Parse.h"
 #if !NO_ANALYSE
 #define BUILDTYPE "SCANNER/PARSER/ANALYSER ONLY"
 #include "Analyse.h"
+#include "SymTab.h"
 #if !NO_CODE
 #undef BUILDTYPE
 #define BUILDTYPE "COMPLETE COMPILER"
 #include "CGen.h"
+#include "Optimise.h"
 #endif
 #else
 #define BUILDTYPE "SCANNER/PARSER ONLY"
@@ -50,7 +55,7 @@
 int lineno = 0;
 
 FILE* source;    /*  The input source file            */
-FILE* listing;   /*  The listing output file          */
+THREADLOCAL FILE* listing;   /*  The listing output file (per thread) */
 FILE* output;      /*  The target code destination file */
 
 /*
@@ -66,8 +71,15 @@ int TraceScan    = FALSE;
 int TraceParse   = FALSE;
 int TraceAnalyse = FALSE;
 int TraceCode    = FALSE;
+int PreLexTokens = FALSE;
+int ScanThreads  = 1;
+int AnalyseThreads = 1;
+int NestingLimit = 10000;
+int BinaryObject = FALSE;
+int ObjectTables = FALSE;
+int OptimiseLevel = 0;
 
-int Error = FALSE;
+THREADLOCAL int Error = FALSE;
 
 /* The syntax tree */
 TreeNode *syntaxTree;
@@ -91,7 +103,7 @@ int ParseCommandLine(int argc, char **argv)
 
 
     opterr = 0;  /* Suppress getopt()'s default error-handing behavior */
-    while ((c = getopt(argc, argv, "slyacf:")) != EOF)
+    while ((c = getopt(argc, argv, "slyactbgj:p:d:O:f:")) != EOF)
     {
         switch(c)
         {
@@ -110,6 +122,37 @@ int ParseCommandLine(int argc, char **argv)
         case 'c':
             TraceCode = TRUE;
             break;
+        case 't':
+            PreLexTokens = TRUE;
+            break;
+        case 'b':
+            BinaryObject = TRUE;
+            break;
+        case 'g':
+            BinaryObject = TRUE;
+            ObjectTables = TRUE;
+            break;
+        case 'j':
+            PreLexTokens = TRUE;
+            ScanThreads = atoi(optarg);
+            if (ScanThreads < 1)
+                errorFlag++;
+            break;
+        case 'p':
+            AnalyseThreads = atoi(optarg);
+            if (AnalyseThreads < 1)
+                errorFlag++;
+            break;
+        case 'd':
+            NestingLimit = atoi(optarg);
+            if (NestingLimit < 1)
+                errorFlag++;
+            break;
+        case 'O':
+            OptimiseLevel = atoi(optarg);
+            if (OptimiseLevel < 0)
+                errorFlag++;
+            break;
         case 'f':
             /* Can't specify filename more than once */
             if (gotSourceName)
@@ -149,6 +192,12 @@ void usage(void)
 
 int main(int argc, char **argv)
 {
+#ifdef SYMTAB_BENCHMARK
+    listing = stdout;
+    benchmarkSymbolTable();
+    return EXIT_SUCCESS;
+#endif
+
     /* Handle the fiddliness of command line arguments elsewhere */
     if (ParseCommandLine(argc, argv) != 0)
     {
@@ -174,10 +223,20 @@ int main(int argc, char **argv)
     /* By default, send output to standard output */
     listing = stdout;
 
+    /* Pull the whole source file into memory for the scanner */
+    if (!initScanner())
+        exit(1);
+
     fprintf(listing, COPYRIGHT "\n");
     fprintf(listing, "*** C- COMPILATION: %s\n", sourceFileName);
     fprintf(listing, "*** Compiler built as " BUILDTYPE " version.\n");
 
+    if (PreLexTokens)
+    {
+        fprintf(listing, "*** Scanning source program...\n");
+        fprintf(listing, "*** Scanned %d tokens\n", lexSource());
+    }
+
     /* If the compiler was built scanner-only, then only run the scanner */
 #if NO_PARSE
     while (getToken() != ENDOFFILE)
@@ -193,25 +252,52 @@ int main(int argc, char **argv)
     {
         fprintf(listing, "*** Dumping syntax tree\n");
         printTree(syntaxTree);
+        printArenaStatistics();
     };
 
 #if !NO_ANALYSE
     if (!Error)
     {
-        fprintf(listing, "*** Building symbol table...\n");
-        buildSymbolTable(syntaxTree);
-        fprintf(listing, "*** Performing type checking...\n");
-        typeCheck(syntaxTree);
+        fprintf(listing, "*** Building symbol table and type checking...\n");
+        analyseProgram(syntaxTree);
+
+        if (TraceAnalyse)
+        {
+            printSymbolTableStatistics();
+            printArenaStatistics();
+        }
     }
 
 #if !NO_CODE
+    if (!Error && (OptimiseLevel >= 1))
+    {
+        int inlined = inlineCalls(syntaxTree, OptimiseLevel);
+
+        if (TraceCode)
+            fprintf(listing, "*** Inlined %d calls\n", inlined);
+    }
+
+    if (!Error)
+    {
+        int rewrites = foldConstants(syntaxTree);
+        int unreachable = markReachable(syntaxTree);
+
+        if (TraceCode)
+        {
+            fprintf(listing, "*** Folded or simplified %d expressions\n",
+                    rewrites);
+            fprintf(listing, "*** Left out %d functions and globals that "
+                    "main() can't reach\n", unreachable);
+        }
+    }
+
     if (!Error)
     {
 		char * codefile;
 		int fnlen = strcspn(sourceFileName,".");
-		codefile = (char *) calloc(fnlen+4, sizeof(char));
+		codefile = (char *) calloc(fnlen+5, sizeof(char));
 		strncpy(codefile,sourceFileName,fnlen);
-		strcat(codefile,".tm");
+		strcat(codefile,BinaryObject ? ".tmo" : ".tm");
         codeGen(syntaxTree, codefile, "output");
 
         /* did code generation succeed? */
@@ -223,6 +309,20 @@ int main(int argc, char **argv)
             if (TraceCode)
                 fprintf(listing,
                         "*** CODE TRACING OPTION ENABLED; see output\n");
+
+            /* read a binary object back, as a runner would */
+            if (TraceCode && BinaryObject)
+            {
+                TMObject object;
+
+                if (loadObject(codefile, &object))
+                {
+                    printObjectSummary(&object);
+                    releaseObject(&object);
+                }
+                else
+                    Error = TRUE;
+            }
         }
     }
 
@@ -230,12 +330,27 @@ int main(int argc, char **argv)
 #endif
 #endif
 
+    /* How much copying and hashing did identifier interning save? */
+    if (TraceScan)
+        printInternStatistics();
+
     if (!Error)
         fprintf(listing,"*** COMPILATION COMPLETE: %d lines processed.\n",
                 lineno);
     else
         fprintf(listing,"*** ERRORS WERE ENCOUNTERED: %d lines processed.\n",
                 lineno);
+
+    releaseScanner();
+
+#if !NO_PARSE && !NO_ANALYSE
+    releaseSymbolTable();
+#endif
+
+    /* the syntax tree, names and labels all go in one go */
+    resetNodePool();
+    releaseInternTable();
+    releaseArena();
 	getchar();
 
 	return EXIT_SUCCESS;
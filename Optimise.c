@@ -0,0 +1,884 @@
+#include <limits.h>
+
+#include "Globals.h"
+#include "CGen.h"
+#include "Intern.h"
+#include "Optimise.h"
+#include "Util.h"
+
+
+/*
+ * Arithmetic is folded as the TM does it, on 32-bit two's complement
+ *  words that wrap around, so it's done on unsigned ints and converted
+ *  back.  A division that would trap at run time (by zero, or INT_MIN by
+ *  -1) is left for the TM to trap on.  A comparison is folded on the sign
+ *  of the wrapped difference, as the TM's SUB and jump make it, so that
+ *  2147483647 > -1 is false at -O1 just as it is at -O0.
+ */
+
+#define WRAP(expression) ((int)(unsigned int)(expression))
+
+/*
+ * The inliner's budgets: a function is inlined if its body, once the
+ *  calls in it have been inlined in turn, is no more than this many
+ *  syntax tree nodes.
+ */
+
+#define INLINEBUDGET1  16   /* at -O1 */
+#define INLINEBUDGET2  48   /* at -O2 and above */
+
+
+/* a function that calls might be inlined in, or to */
+typedef struct
+{
+    TreeNode *function;
+    int      pending;     /* calls in it to functions not yet dealt with */
+    int      firstCall;   /* its first entry in the calls, by callee */
+    int      inlinable;
+} InlineFunction;
+
+/* a call from one function to another, by their InlineFunction entries */
+typedef struct
+{
+    int callee;
+    int caller;
+} InlineCall;
+
+/* what a declaration in the callee becomes in the caller */
+typedef struct
+{
+    NodeIndex from;
+    NodeIndex to;     /* a declaration, or a constant to use instead */
+} Renaming;
+
+/* a call being inlined */
+typedef struct
+{
+    TreeNode *caller;
+    Renaming *renamings;
+    int      count;
+    int      capacity;
+} InlineSite;
+
+
+/*********************************************************************
+ *  Module-static function declarations
+ */
+
+/* the InlineFunction entry of a function declaration, or -1 */
+static int findFunction(InlineFunction *functions, int count,
+                        NodeIndex declaration);
+static int compareFunctions(const void *left, const void *right);
+static int compareCalls(const void *left, const void *right);
+
+/* inlines the calls in one function that can be; returns how many */
+static int inlineInto(InlineFunction *functions, int count, int caller);
+
+/* may calls to a function, whose own calls are dealt with, be inlined? */
+static int isInlinable(TreeNode *function, int budget);
+
+/* replaces a call with a copy of the callee's body */
+static int inlineCall(TreeNode *call, TreeNode *callee, TreeNode *caller);
+static TreeNode *copyTree(TreeNode *tree, InlineSite *site);
+static TreeNode *copyNode(TreeNode *tree);
+static void layoutLocal(TreeNode *declaration, TreeNode *caller);
+static void addRenaming(InlineSite *site, NodeIndex from, NodeIndex to);
+static NodeIndex findRenaming(InlineSite *site, NodeIndex from);
+
+/* does a function's body assign to a variable, or index an array? */
+static int isAssigned(TreeNode *body, NodeIndex variable);
+static int isIndexed(TreeNode *body, NodeIndex array);
+
+/* folds and simplifies one operator whose operands have been already */
+static int foldOperator(TreeNode *tree);
+
+/* the value of "left op right", if it can be worked out now */
+static int foldValue(int op, int left, int right, int *value);
+
+/* could evaluating an expression do anything but produce its value? */
+static int hasSideEffects(TreeNode *tree);
+
+/* turns a node into a constant, or into a copy of another node */
+static void makeConstant(TreeNode *tree, int value);
+static void replaceNode(TreeNode *tree, TreeNode *by);
+
+/* is a node the constant "value"? */
+static int isConstant(TreeNode *tree, int value);
+
+/* marks a declaration reachable, and queues a function to be looked at */
+static TreeNode **reach(TreeNode *declaration, TreeNode **functions,
+                        int *count, int *capacity);
+
+
+/*********************************************************************
+ *  Public function definitions
+ */
+
+/*
+ * Functions are dealt with callees first, so that the body copied into a
+ *  caller has had its own calls inlined already, and is as big as it's
+ *  going to get.  A function on a cycle of calls -- one that's recursive,
+ *  like gcd(), or that calls one that is -- is never ready to be dealt
+ *  with, so it's never inlined; calls in it are inlined at the end.
+ */
+
+int inlineCalls(TreeNode *syntaxTree, int level)
+{
+    InlineFunction *functions = NULL;
+    InlineCall     *calls = NULL;
+    int            *ready = NULL;   /* functions whose callees are done */
+    int            numFunctions = 0, functionCapacity = 0;
+    int            numCalls = 0, callCapacity = 0;
+    int            numReady = 0, readyCapacity = 0;
+    int            budget = (level >= 2) ? INLINEBUDGET2 : INLINEBUDGET1;
+    int            inlined = 0;
+    int            caller, callee;
+    int            i;
+    TreeNode       *node;
+    TreeWalk       walk;
+    int            step;
+
+    for (node = syntaxTree; node != NULL; node = NODE(node->sibling))
+        if (node->kind.dec == FuncDecK)
+        {
+            functions = (InlineFunction*)growStack(functions, numFunctions,
+                        &functionCapacity, sizeof(InlineFunction));
+            functions[numFunctions].function = node;
+            functions[numFunctions].pending = 0;
+            functions[numFunctions].firstCall = 0;
+            functions[numFunctions].inlinable = FALSE;
+            ++numFunctions;
+        }
+    if (numFunctions > 0)
+        qsort(functions, numFunctions, sizeof(InlineFunction),
+              compareFunctions);
+
+    /* find every call from one function to another */
+    for (caller = 0; caller < numFunctions; ++caller)
+    {
+        startWalk(&walk, NODE(functions[caller].function->child[1]));
+        while ((step = walkTree(&walk)) != WALKDONE)
+        {
+            node = walk.node;
+            if ((step == WALKENTER) && (node->nodekind == StmtK)
+                    && (node->kind.stmt == CallK)
+                    && ((callee = findFunction(functions, numFunctions,
+                                               node->declaration)) >= 0))
+            {
+                calls = (InlineCall*)growStack(calls, numCalls,
+                                               &callCapacity,
+                                               sizeof(InlineCall));
+                calls[numCalls].callee = callee;
+                calls[numCalls].caller = caller;
+                ++numCalls;
+                ++functions[caller].pending;
+            }
+        }
+        endWalk(&walk);
+    }
+    if (numCalls > 0)
+        qsort(calls, numCalls, sizeof(InlineCall), compareCalls);
+
+    for (i = 0; i < numFunctions; ++i)
+        functions[i].firstCall = numCalls;
+    for (i = numCalls - 1; i >= 0; --i)
+        functions[calls[i].callee].firstCall = i;
+
+    for (i = 0; i < numFunctions; ++i)
+        if (functions[i].pending == 0)
+        {
+            ready = (int*)growStack(ready, numReady, &readyCapacity,
+                                    sizeof(int));
+            ready[numReady++] = i;
+        }
+
+    while ((numReady > 0) && !Error)
+    {
+        callee = ready[--numReady];
+
+        inlined += inlineInto(functions, numFunctions, callee);
+        functions[callee].inlinable =
+            isInlinable(functions[callee].function, budget);
+
+        /* its callers are a call nearer being ready */
+        for (i = functions[callee].firstCall;
+                (i < numCalls) && (calls[i].callee == callee); ++i)
+        {
+            caller = calls[i].caller;
+            if (--functions[caller].pending == 0)
+            {
+                ready = (int*)growStack(ready, numReady, &readyCapacity,
+                                        sizeof(int));
+                ready[numReady++] = caller;
+            }
+        }
+    }
+
+    for (i = 0; (i < numFunctions) && !Error; ++i)
+        if (functions[i].pending > 0)
+            inlined += inlineInto(functions, numFunctions, i);
+
+    free(functions);
+    free(calls);
+    free(ready);
+
+    return inlined;
+}
+
+
+int foldConstants(TreeNode *syntaxTree)
+{
+    TreeWalk walk;
+    int      step;
+    int      rewrites = 0;
+
+    /* operands are left before their operator, so fold on the way out */
+    startWalk(&walk, syntaxTree);
+    while ((step = walkTree(&walk)) != WALKDONE)
+        if ((step == WALKLEAVE) && (walk.node->nodekind == ExpK)
+                && (walk.node->kind.exp == OpK))
+            rewrites += foldOperator(walk.node);
+    endWalk(&walk);
+
+    return rewrites;
+}
+
+
+int markReachable(TreeNode *syntaxTree)
+{
+    TreeNode *node;
+    TreeNode *function;
+    TreeNode **functions = NULL;  /* reached, but not looked at yet */
+    int      count = 0;
+    int      capacity = 0;
+    TreeWalk walk;
+    int      step;
+    int      i;
+    int      globalOffset = 0;
+    int      unreachable = 0;
+    char     *mainName = internName("main");
+
+    for (node = syntaxTree; node != NULL; node = NODE(node->sibling))
+        if ((node->kind.dec == FuncDecK) && (node->name == mainName))
+            functions = reach(node, functions, &count, &capacity);
+
+    /* look through each function reached for what it uses in turn */
+    while (count > 0)
+    {
+        function = functions[--count];
+
+        for (i = 0; i < MAXCHILDREN; ++i)
+        {
+            startWalk(&walk, NODE(function->child[i]));
+            while ((step = walkTree(&walk)) != WALKDONE)
+            {
+                node = walk.node;
+                if ((step == WALKENTER) && (node->declaration != 0)
+                        && (((node->nodekind == ExpK)
+                             && (node->kind.exp == IdK))
+                            || ((node->nodekind == StmtK)
+                                && (node->kind.stmt == CallK))))
+                    functions = reach(NODE(node->declaration), functions,
+                                      &count, &capacity);
+            }
+            endWalk(&walk);
+        }
+    }
+
+    free(functions);
+
+    /* the globals that are left close up */
+    for (node = syntaxTree; node != NULL; node = NODE(node->sibling))
+    {
+        if (!DECINFO(node)->isReachable)
+            ++unreachable;
+        else if (node->kind.dec != FuncDecK)
+        {
+            DECINFO(node)->offset = globalOffset;
+            globalOffset += DECINFO(node)->localSize;
+        }
+    }
+
+    return unreachable;
+}
+
+
+/*********************************************************************
+ *  Static function definitions
+ */
+
+static int findFunction(InlineFunction *functions, int count,
+                        NodeIndex declaration)
+{
+    int low = 0;
+    int high = count - 1;
+    int middle;
+
+    while (low <= high)
+    {
+        middle = (low + high) / 2;
+        if (functions[middle].function->index == declaration)
+            return middle;
+        else if (functions[middle].function->index < declaration)
+            low = middle + 1;
+        else
+            high = middle - 1;
+    }
+
+    return -1;
+}
+
+
+static int compareFunctions(const void *left, const void *right)
+{
+    NodeIndex l = ((const InlineFunction*)left)->function->index;
+    NodeIndex r = ((const InlineFunction*)right)->function->index;
+
+    return (l > r) - (l < r);
+}
+
+
+static int compareCalls(const void *left, const void *right)
+{
+    return ((const InlineCall*)left)->callee
+           - ((const InlineCall*)right)->callee;
+}
+
+
+static int inlineInto(InlineFunction *functions, int count, int caller)
+{
+    TreeNode *function = functions[caller].function;
+    TreeNode *node;
+    TreeWalk walk;
+    int      step;
+    int      callee;
+    int      inlined = 0;
+
+    /* arguments are left before their call, so inline on the way out */
+    startWalk(&walk, NODE(function->child[1]));
+    while (((step = walkTree(&walk)) != WALKDONE) && !Error)
+    {
+        node = walk.node;
+        if ((step == WALKLEAVE) && (node->nodekind == StmtK)
+                && (node->kind.stmt == CallK)
+                && ((callee = findFunction(functions, count,
+                                           node->declaration)) >= 0)
+                && functions[callee].inlinable
+                && inlineCall(node, functions[callee].function, function))
+            ++inlined;
+    }
+    endWalk(&walk);
+
+    return inlined;
+}
+
+
+/*
+ * A global scalar is addressed off mp, as a local is (see genValue()), so
+ *  it wouldn't be the same variable in the caller's frame; a function
+ *  that uses one stays where it is.
+ */
+static int isInlinable(TreeNode *function, int budget)
+{
+    TreeNode *node;
+    TreeWalk walk;
+    int      step;
+    int      size = 0;
+    int      inlinable = (function->name != internName("main"));
+
+    startWalk(&walk, NODE(function->child[1]));
+    while (inlinable && ((step = walkTree(&walk)) != WALKDONE))
+    {
+        node = walk.node;
+        if (step != WALKENTER)
+            continue;
+
+        if (++size > budget)
+            inlinable = FALSE;
+        else if ((node->nodekind == ExpK) && (node->kind.exp == IdK)
+                 && (NODE(node->declaration)->kind.dec == ScalarDecK)
+                 && DECINFO(NODE(node->declaration))->isGlobal)
+            inlinable = FALSE;
+    }
+    endWalk(&walk);
+
+    return inlinable;
+}
+
+
+/*
+ * An array argument, a constant, or a local variable is used in the body
+ *  in place of its parameter, as long as nothing in the body assigns the
+ *  parameter; the variable mustn't change while the arguments are worked
+ *  out, either.  Every other parameter gets a copy in the caller's frame,
+ *  assigned its argument ahead of the body.
+ *
+ * An array parameter is indexed off gp, like a global array, whatever was
+ *  passed (see genValue()); a local array of the caller isn't, so a call
+ *  that passes one to a parameter the body indexes is left alone.
+ */
+static int inlineCall(TreeNode *call, TreeNode *callee, TreeNode *caller)
+{
+    InlineSite site;
+    TreeNode   *parameter;
+    TreeNode   *argument;
+    TreeNode   *next;
+    TreeNode   *copy;
+    TreeNode   *variable;
+    TreeNode   *binding;
+    TreeNode   *declarations = NULL, *lastDeclaration = NULL;
+    TreeNode   *statements = NULL, *lastStatement = NULL;
+    TreeNode   *body = NODE(callee->child[1]);
+    int        pure;
+
+    parameter = NODE(callee->child[0]);
+    for (argument = NODE(call->child[0]); argument != NULL;
+            argument = NODE(argument->sibling))
+    {
+        if ((parameter->kind.dec == ArrayDecK)
+                && !DECINFO(NODE(argument->declaration))->isGlobal
+                && !DECINFO(NODE(argument->declaration))->isParameter
+                && isIndexed(body, parameter->index))
+            return FALSE;
+        parameter = NODE(parameter->sibling);
+    }
+
+    /* the walk goes on to the first argument's siblings: all of them */
+    pure = !hasSideEffects(NODE(call->child[0]));
+
+    site.caller = caller;
+    site.renamings = NULL;
+    site.count = site.capacity = 0;
+
+    parameter = NODE(callee->child[0]);
+    for (argument = NODE(call->child[0]); (argument != NULL) && !Error;
+            argument = next)
+    {
+        next = NODE(argument->sibling);
+
+        if (parameter->kind.dec == ArrayDecK)
+            addRenaming(&site, parameter->index, argument->declaration);
+        else if ((argument->nodekind == ExpK)
+                 && (argument->kind.exp == ConstK)
+                 && !isAssigned(body, parameter->index))
+            addRenaming(&site, parameter->index, argument->index);
+        else if (pure && (argument->nodekind == ExpK)
+                 && (argument->kind.exp == IdK) && (argument->child[0] == 0)
+                 && (NODE(argument->declaration)->kind.dec == ScalarDecK)
+                 && !DECINFO(NODE(argument->declaration))->isGlobal
+                 && !isAssigned(body, parameter->index))
+            addRenaming(&site, parameter->index, argument->declaration);
+        else
+        {
+            copy = copyNode(parameter);
+            variable = newExpNode(IdK);
+            binding = newExpNode(AssignK);
+            if ((copy == NULL) || (variable == NULL) || (binding == NULL))
+            {
+                Error = TRUE;
+                break;
+            }
+
+            layoutLocal(copy, caller);
+            addRenaming(&site, parameter->index, copy->index);
+
+            variable->name = copy->name;
+            variable->declaration = copy->index;
+            variable->expressionType = Integer;
+            variable->lineno = call->lineno;
+
+            binding->child[0] = variable->index;
+            binding->child[1] = argument->index;
+            binding->expressionType = Integer;
+            binding->lineno = call->lineno;
+            argument->sibling = 0;
+
+            if (lastDeclaration == NULL)
+                declarations = copy;
+            else
+                lastDeclaration->sibling = copy->index;
+            lastDeclaration = copy;
+
+            if (lastStatement == NULL)
+                statements = binding;
+            else
+                lastStatement->sibling = binding->index;
+            lastStatement = binding;
+        }
+
+        parameter = NODE(parameter->sibling);
+    }
+
+    body = copyTree(body, &site);
+    free(site.renamings);
+    if (Error)
+        return FALSE;
+
+    if (lastStatement == NULL)
+        statements = body;
+    else
+        lastStatement->sibling = nodeIndex(body);
+
+    call->kind.stmt = InlineK;
+    call->child[0] = nodeIndex(declarations);
+    call->child[1] = nodeIndex(statements);
+
+    return TRUE;
+}
+
+
+/*
+ * copyTree(): copies a list of the callee's nodes, and everything under
+ *  them, into the caller.  What's copied is no bigger than the inlining
+ *  budget, so it's safe to recurse.
+ */
+static TreeNode *copyTree(TreeNode *tree, InlineSite *site)
+{
+    TreeNode  *first = NULL;
+    TreeNode  *last = NULL;
+    TreeNode  *copy;
+    TreeNode  *by;
+    int       i;
+
+    for (; (tree != NULL) && !Error; tree = NODE(tree->sibling))
+    {
+        copy = copyNode(tree);
+        if (copy == NULL)
+            break;
+
+        if (tree->nodekind == DecK)
+        {
+            layoutLocal(copy, site->caller);
+            addRenaming(site, tree->index, copy->index);
+        }
+        else if ((tree->nodekind == ExpK) && (tree->kind.exp == IdK)
+                 && ((by = NODE(findRenaming(site, tree->declaration)))
+                     != NULL))
+        {
+            if (by->nodekind == DecK)
+            {
+                copy->declaration = by->index;
+                copy->name = by->name;
+            }
+            else
+                makeConstant(copy, by->val);
+        }
+
+        for (i = 0; i < MAXCHILDREN; ++i)
+            copy->child[i] = nodeIndex(copyTree(NODE(tree->child[i]), site));
+
+        if (last == NULL)
+            first = copy;
+        else
+            last->sibling = copy->index;
+        last = copy;
+    }
+
+    return first;
+}
+
+
+/* a node like "tree", with a DecInfo entry of its own if it needs one */
+static TreeNode *copyNode(TreeNode *tree)
+{
+    TreeNode     *copy;
+    NodeIndex    index;
+    unsigned int decInfo;
+
+    if (tree->nodekind == DecK)
+        copy = newDecNode((DecKind)tree->kind.dec);
+    else
+        copy = newExpNode(EErrorK);
+
+    if (copy == NULL)
+    {
+        Error = TRUE;
+        return NULL;
+    }
+
+    index = copy->index;
+    decInfo = copy->decInfo;
+    *copy = *tree;
+    copy->index = index;
+    copy->decInfo = decInfo;
+    copy->sibling = 0;
+
+    if (tree->nodekind == DecK)
+        *DECINFO(copy) = *DECINFO(tree);
+
+    return copy;
+}
+
+
+/* gives a copied variable a place of its own below the caller's locals */
+static void layoutLocal(TreeNode *declaration, TreeNode *caller)
+{
+    DecInfo *decInfo = DECINFO(declaration);
+    DecInfo *frame = DECINFO(caller);
+
+    decInfo->isParameter = FALSE;
+    decInfo->localSize = varSize(declaration);
+
+    frame->localSize += decInfo->localSize;
+    decInfo->offset = 1 - frame->localSize;
+}
+
+
+static void addRenaming(InlineSite *site, NodeIndex from, NodeIndex to)
+{
+    site->renamings = (Renaming*)growStack(site->renamings, site->count,
+                                           &site->capacity,
+                                           sizeof(Renaming));
+    site->renamings[site->count].from = from;
+    site->renamings[site->count].to = to;
+    ++site->count;
+}
+
+
+static NodeIndex findRenaming(InlineSite *site, NodeIndex from)
+{
+    int i;
+
+    for (i = 0; i < site->count; ++i)
+        if (site->renamings[i].from == from)
+            return site->renamings[i].to;
+
+    return 0;
+}
+
+
+static int isAssigned(TreeNode *body, NodeIndex variable)
+{
+    TreeWalk walk;
+    int      step;
+    int      found = FALSE;
+
+    startWalk(&walk, body);
+    while (!found && ((step = walkTree(&walk)) != WALKDONE))
+        if ((step == WALKENTER) && (walk.node->nodekind == ExpK)
+                && (walk.node->kind.exp == AssignK))
+            found = (NODE(walk.node->child[0])->declaration == variable);
+    endWalk(&walk);
+
+    return found;
+}
+
+
+static int isIndexed(TreeNode *body, NodeIndex array)
+{
+    TreeWalk walk;
+    int      step;
+    int      found = FALSE;
+
+    startWalk(&walk, body);
+    while (!found && ((step = walkTree(&walk)) != WALKDONE))
+        if ((step == WALKENTER) && (walk.node->nodekind == ExpK)
+                && (walk.node->kind.exp == IdK))
+            found = ((walk.node->declaration == array)
+                     && (walk.node->child[0] != 0));
+    endWalk(&walk);
+
+    return found;
+}
+
+
+static int foldOperator(TreeNode *tree)
+{
+    TreeNode *left = NODE(tree->child[0]);
+    TreeNode *right = NODE(tree->child[1]);
+    TreeNode *inner;
+    int      value;
+    int      rewrites = 0;
+
+    if ((left->nodekind == ExpK) && (left->kind.exp == ConstK)
+            && (right->nodekind == ExpK) && (right->kind.exp == ConstK))
+    {
+        if (!foldValue(tree->op, left->val, right->val, &value))
+            return 0;
+
+        makeConstant(tree, value);
+        return 1;
+    }
+
+    /* (x + c1) + c2, and the like, is x + (c1 + c2) */
+    if (((tree->op == PLUS) || (tree->op == MINUS))
+            && (right->nodekind == ExpK) && (right->kind.exp == ConstK)
+            && (left->nodekind == ExpK) && (left->kind.exp == OpK)
+            && ((left->op == PLUS) || (left->op == MINUS)))
+    {
+        inner = NODE(left->child[1]);
+        if ((inner->nodekind == ExpK) && (inner->kind.exp == ConstK))
+        {
+            value = (left->op == PLUS) ? inner->val : WRAP(0u - inner->val);
+            value = (tree->op == PLUS) ? WRAP((unsigned)value + right->val)
+                    : WRAP((unsigned)value - right->val);
+
+            tree->op = PLUS;
+            tree->child[0] = left->child[0];
+            right->val = value;
+            left = NODE(tree->child[0]);
+            ++rewrites;
+        }
+    }
+
+    switch (tree->op)
+    {
+    case PLUS:
+        if (isConstant(right, 0))
+            replaceNode(tree, left);
+        else if (isConstant(left, 0))
+            replaceNode(tree, right);
+        else
+            return rewrites;
+        break;
+
+    case MINUS:
+        if (isConstant(right, 0))
+            replaceNode(tree, left);
+        else
+            return rewrites;
+        break;
+
+    case TIMES:
+        if (isConstant(right, 1))
+            replaceNode(tree, left);
+        else if (isConstant(left, 1))
+            replaceNode(tree, right);
+        else if ((isConstant(right, 0) && !hasSideEffects(left))
+                 || (isConstant(left, 0) && !hasSideEffects(right)))
+            makeConstant(tree, 0);
+        else
+            return rewrites;
+        break;
+
+    case DIVIDE:
+        if (isConstant(right, 1))
+            replaceNode(tree, left);
+        else
+            return rewrites;
+        break;
+
+    default:
+        return rewrites;
+    }
+
+    return rewrites + 1;
+}
+
+
+static int foldValue(int op, int left, int right, int *value)
+{
+    int difference = WRAP((unsigned int)left - (unsigned int)right);
+
+    switch (op)
+    {
+    case PLUS:
+        *value = WRAP((unsigned int)left + (unsigned int)right);
+        break;
+    case MINUS:
+        *value = WRAP((unsigned int)left - (unsigned int)right);
+        break;
+    case TIMES:
+        *value = WRAP((unsigned int)left * (unsigned int)right);
+        break;
+    case DIVIDE:
+        if ((right == 0) || ((left == INT_MIN) && (right == -1)))
+            return FALSE;
+        *value = left / right;
+        break;
+    case LT:
+        *value = (difference < 0);
+        break;
+    case LTE:
+        *value = (difference <= 0);
+        break;
+    case GT:
+        *value = (difference > 0);
+        break;
+    case GTE:
+        *value = (difference >= 0);
+        break;
+    case EQ:
+        *value = (difference == 0);
+        break;
+    case NE:
+        *value = (difference != 0);
+        break;
+    default:
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+static int hasSideEffects(TreeNode *tree)
+{
+    TreeWalk walk;
+    int      step;
+    int      found = FALSE;
+
+    /* an operand has no siblings, so this is just its own subtree */
+    startWalk(&walk, tree);
+    while (!found && ((step = walkTree(&walk)) != WALKDONE))
+        if (step == WALKENTER)
+            found = ((walk.node->nodekind == StmtK)   /* a call */
+                     || ((walk.node->nodekind == ExpK)
+                         && (walk.node->kind.exp == AssignK)));
+    endWalk(&walk);
+
+    return found;
+}
+
+
+static void makeConstant(TreeNode *tree, int value)
+{
+    int i;
+
+    tree->kind.exp = ConstK;
+    tree->val = value;
+    tree->name = NULL;
+    tree->declaration = 0;
+    for (i = 0; i < MAXCHILDREN; ++i)
+        tree->child[i] = 0;
+}
+
+
+/* the node keeps its own place in the pool, and its own siblings */
+static void replaceNode(TreeNode *tree, TreeNode *by)
+{
+    NodeIndex index = tree->index;
+    NodeIndex sibling = tree->sibling;
+
+    *tree = *by;
+    tree->index = index;
+    tree->sibling = sibling;
+}
+
+
+static int isConstant(TreeNode *tree, int value)
+{
+    return (tree->nodekind == ExpK) && (tree->kind.exp == ConstK)
+           && (tree->val == value);
+}
+
+
+static TreeNode **reach(TreeNode *declaration, TreeNode **functions,
+                        int *count, int *capacity)
+{
+    if (DECINFO(declaration)->isReachable)
+        return functions;
+
+    DECINFO(declaration)->isReachable = TRUE;
+    if (declaration->kind.dec == FuncDecK)
+    {
+        functions = (TreeNode**)growStack(functions, *count, capacity,
+                                          sizeof(TreeNode*));
+        functions[(*count)++] = declaration;
+    }
+
+    return functions;
+}
+
+
+/* END OF FILE */
@@ -0,0 +1,45 @@
+
+
+
+#ifndef OPTIMISE_H
+#define OPTIMISE_H
+
+#include "Globals.h"
+
+/*
+ * NAME:    inlineCalls()
+ * PURPOSE: Replaces calls to small functions with copies of their bodies,
+ *           the parameters and locals moved into the caller's frame.  The
+ *           size allowed grows with the optimisation "level".  Recursive
+ *           functions are never inlined.  Returns how many calls it
+ *           replaced.
+ */
+
+int inlineCalls(TreeNode *syntaxTree, int level);
+
+
+/*
+ * NAME:    foldConstants()
+ * PURPOSE: Rewrites a type checked syntax tree in place, folding operators
+ *           whose operands are both constants, and applying the algebraic
+ *           identities that can't change what the program does (x+0, x-0,
+ *           x*1, x/1, x*0 of an x with no side effects, and (x+c1)+c2).
+ *           Returns how many rewrites it made.
+ */
+
+int foldConstants(TreeNode *syntaxTree);
+
+
+/*
+ * NAME:    markReachable()
+ * PURPOSE: Follows calls and references out from main() to mark the
+ *           functions and globals it can reach, and lays the reachable
+ *           globals out again side by side.  The code generator leaves
+ *           the rest out.  Returns how many declarations are left out.
+ */
+
+int markReachable(TreeNode *syntaxTree);
+
+#endif
+
+/* END OF FILE */
@@ -21,17 +21,11 @@ static TreeNode *param(void);
 
 static TreeNode *compound_statement(void);
 static TreeNode *local_declarations(void);
-static TreeNode *statement_list(void);
-static TreeNode *statement(void);
 static TreeNode *expression_statement(void);
-static TreeNode *selection_statement(void);
-static TreeNode *iteration_statement(void);
 static TreeNode *return_statement(void);
 static TreeNode *expression(void);
-static TreeNode *simple_expression(TreeNode *passdown);
-static TreeNode *additive_expression(TreeNode *passdown);
-static TreeNode *term(TreeNode *passdown);
-static TreeNode *factor(TreeNode *passdown);
+static TreeNode *binary_expression(TreeNode *passdown, int minPower);
+static TreeNode *factor(void);
 static TreeNode *args(void);
 static TreeNode *arg_list(void);
 
@@ -114,7 +108,7 @@ static TreeNode *declaration_list(void)
         q = declaration();
         if ((q != NULL) && (ptr != NULL))
         {
-            ptr->sibling = q;
+            ptr->sibling = nodeIndex(q);
             ptr = q;
         }
     }
@@ -136,7 +130,7 @@ static TreeNode *declaration(void)
 
     decType = matchType();   /* get type of declaration */
 
-    identifier = copyString(tokenString);
+    identifier = tokenSymbol;
     match(ID);
 
     switch(token)
@@ -147,7 +141,7 @@ static TreeNode *declaration(void)
 
         if (tree != NULL)
         {
-            tree->variableDataType = decType;
+            DECINFO(tree)->variableDataType = decType;
             tree->name = identifier;
         }
 
@@ -159,7 +153,7 @@ static TreeNode *declaration(void)
 
         if (tree != NULL)
         {
-            tree->variableDataType = decType;
+            DECINFO(tree)->variableDataType = decType;
             tree->name = identifier;
         }
 
@@ -177,14 +171,14 @@ static TreeNode *declaration(void)
 
         if (tree != NULL)
         {
-            tree->functionReturnType = decType;
+            DECINFO(tree)->functionReturnType = decType;
             tree->name = identifier;
         }
 
         match(LPAREN);
-        if (tree != NULL) tree->child[0] = param_list();
+        if (tree != NULL) tree->child[0] = nodeIndex(param_list());
         match(RPAREN);
-        if (tree != NULL) tree->child[1] = compound_statement();
+        if (tree != NULL) tree->child[1] = nodeIndex(compound_statement());
         break;
 
     default:
@@ -212,7 +206,7 @@ static TreeNode *var_declaration(void)
 
     decType = matchType();
 
-    identifier = copyString(tokenString);
+    identifier = tokenSymbol;
     match(ID);
 
     switch(token)
@@ -223,7 +217,7 @@ static TreeNode *var_declaration(void)
 
         if (tree != NULL)
         {
-            tree->variableDataType = decType;
+            DECINFO(tree)->variableDataType = decType;
             tree->name = identifier;
         }
 
@@ -235,7 +229,7 @@ static TreeNode *var_declaration(void)
 
         if (tree != NULL)
         {
-            tree->variableDataType = decType;
+            DECINFO(tree)->variableDataType = decType;
             tree->name = identifier;
         }
 
@@ -271,7 +265,7 @@ static TreeNode *param(void)
 
     parmType = matchType();  /* get type of formal parameter */
 
-    identifier = copyString(tokenString);
+    identifier = tokenSymbol;
     match(ID);
 
     /* array-type formal parameter */
@@ -289,8 +283,8 @@ static TreeNode *param(void)
     {
         tree->name = identifier;
         tree->val = 0;
-        tree->variableDataType = parmType;
-        tree->isParameter = TRUE;
+        DECINFO(tree)->variableDataType = parmType;
+        DECINFO(tree)->isParameter = TRUE;
     }
 
     return tree;
@@ -321,7 +315,7 @@ static TreeNode *param_list(void)
         newNode = param();
         if (newNode != NULL)
         {
-            ptr->sibling = newNode;
+            ptr->sibling = nodeIndex(newNode);
             ptr = newNode;
         }
     }
@@ -330,30 +324,6 @@ static TreeNode *param_list(void)
 }
 
 
-static TreeNode *compound_statement(void)
-{
-    TreeNode *tree = NULL;
-
-    DEBUG_ONLY( fprintf(listing, "*** Entered compound_statement()\n"); )
-
-    match(LBRACE);
-
-    if ((token != RBRACE) && (tree = newStmtNode(CompoundK)))
-    {
-        if (isAType(token))
-            tree->child[0] = local_declarations();
-        if (token != RBRACE)
-            tree->child[1] = statement_list();
-    }
-
-    match(RBRACE);
-
-    DEBUG_ONLY( fprintf(listing, "*** Exiting compound_statement()\n"); )
-
-    return tree;
-}
-
-
 static TreeNode *local_declarations(void)
 {
     TreeNode *tree=NULL;
@@ -376,7 +346,7 @@ static TreeNode *local_declarations(void)
             newNode = var_declaration();
             if (newNode != NULL)
             {
-                ptr->sibling = newNode;
+                ptr->sibling = nodeIndex(newNode);
                 ptr = newNode;
             }
         }
@@ -386,152 +356,283 @@ static TreeNode *local_declarations(void)
 }
 
 
-static TreeNode *statement_list(void)
+/*
+ * If, while and compound statements nest inside one another, and a
+ *  deeply nested program mustn't run the parser out of C stack.  So
+ *  rather than have statement(), compound_statement() and friends call
+ *  one another, compound_statement() runs them all as a loop, keeping the
+ *  statements it's part-way through on a stack of ParseFrames.  Each
+ *  frame says what to do with the next statement that gets finished.
+ */
+
+typedef enum
 {
-    TreeNode *tree = NULL;
-    TreeNode *ptr;
-    TreeNode *newNode;
+    InStatement,      /* it's the whole statement: just return it    */
+    InThenPart,       /* it's the then-part of an if-statement        */
+    InElsePart,       /* it's the else-part                           */
+    InWhileBody,      /* it's the body of a while-statement           */
+    InStatementList   /* it's the next in a compound's statement list */
+} FrameKind;
+
+typedef struct
+{
+    FrameKind kind;
+    TreeNode  *tree;      /* the if/while test, or the compound statement */
+    TreeNode  *first;     /* the then-part, or the first in the list */
+    TreeNode  *last;      /* the last in the list */
+    int       gotFirst;   /* seen the first in the list yet? */
+} ParseFrame;
 
-    DEBUG_ONLY( fprintf(listing, "*** Entered statement_list()\n"); )
+/* the steps compound_statement() goes through */
+typedef enum { BeginStatement, BeginCompound, EndStatement } ParseStep;
 
-    if (token != RBRACE)
-    {
-        tree = statement();
-        ptr = tree;
+static ParseFrame *frames = NULL;
+static int        frameCount = 0;
+static int        frameCapacity = 0;
 
-        while (token != RBRACE)
-        {
-            newNode = statement();
-            if ((ptr != NULL) && (newNode != NULL))
-            {
-                ptr->sibling = newNode;
-                ptr = newNode;
-            }
-        }
-    }
+/* how many if, while and compound statements we're inside */
+static int        statementDepth = 0;
 
-    DEBUG_ONLY( fprintf(listing, "*** Exiting statement_list()\n"); )
 
-    return tree;
+static ParseFrame *pushFrame(FrameKind kind)
+{
+    ParseFrame *frame;
+
+    frames = (ParseFrame*)growStack(frames, frameCount, &frameCapacity,
+                                    sizeof(ParseFrame));
+
+    frame = &frames[frameCount++];
+    frame->kind = kind;
+    frame->tree = frame->first = frame->last = NULL;
+    frame->gotFirst = FALSE;
+
+    return frame;
 }
 
 
-static TreeNode *statement(void)
+/* Note that we're one if, while or compound statement deeper */
+static void enterStatement(void)
 {
-    TreeNode *tree = NULL;
-
-    DEBUG_ONLY( fprintf(listing, "*** Entered statement()\n"); )
+    char message[80];
 
-    switch(token)
+    if (++statementDepth == NestingLimit + 1)
     {
-    case IF:
-        tree = selection_statement();
-        break;
-    case WHILE:
-        tree = iteration_statement();
-        break;
-    case RETURN:
-        tree = return_statement();
-        break;
-    case LBRACE:
-        tree = compound_statement();
-        break;
-    case ID:
-    case SEMI:
-    case LPAREN:
-    case NUM:
-        tree = expression_statement();
-        break;
-    default:
-        syntaxError("unexpected token ");
-        printToken(token, tokenString);
-        fprintf(listing, "\n");
-        token = getToken();
-        break;
+        sprintf(message, "statements nested more than %d deep\n",
+                NestingLimit);
+        syntaxError(message);
     }
-
-    DEBUG_ONLY( fprintf(listing, "*** Exiting statement()\n"); )
-
-    return tree;
 }
 
 
-static TreeNode *expression_statement(void)
+static TreeNode *compound_statement(void)
 {
-    TreeNode *tree = NULL;
-
-    DEBUG_ONLY( fprintf(listing, "*** Entered expression_statement()\n"); )
+    ParseFrame *frame;
+    ParseStep  step = BeginCompound;
+    TreeNode   *tree = NULL;    /* the statement most recently finished */
+    TreeNode   *newNode;
 
-    if (token == SEMI)
-        match(SEMI);
-    else if (token != RBRACE)
+    for (;;)
     {
-        tree = expression();
-        match(SEMI);
-    }
+        switch (step)
+        {
+        case BeginStatement:
 
-    DEBUG_ONLY( fprintf(listing, "*** Exiting expression_statement()\n"); )
+            DEBUG_ONLY( fprintf(listing, "*** Entered statement()\n"); )
 
-    return tree;
-}
+            pushFrame(InStatement);
+            step = EndStatement;
+            tree = NULL;
 
+            switch(token)
+            {
+            case IF:
+                DEBUG_ONLY( fprintf(listing, "*** Entered selection_statement()\n"); )
+
+                enterStatement();
+                match(IF);
+                match(LPAREN);
+                frame = pushFrame(InThenPart);
+                frame->tree = expression();
+                match(RPAREN);
+                step = BeginStatement;
+                break;
+            case WHILE:
+                DEBUG_ONLY( fprintf(listing, "*** Entered iteration_statement()\n"); )
+
+                enterStatement();
+                match(WHILE);
+                match(LPAREN);
+                frame = pushFrame(InWhileBody);
+                frame->tree = expression();
+                match(RPAREN);
+                step = BeginStatement;
+                break;
+            case RETURN:
+                tree = return_statement();
+                break;
+            case LBRACE:
+                step = BeginCompound;
+                break;
+            case ID:
+            case SEMI:
+            case LPAREN:
+            case NUM:
+                tree = expression_statement();
+                break;
+            default:
+                syntaxError("unexpected token ");
+                printToken(token, tokenString);
+                fprintf(listing, "\n");
+                token = getToken();
+                break;
+            }
 
-static TreeNode *selection_statement(void)
-{
-    TreeNode *tree;
-    TreeNode *expr;
-    TreeNode *ifStmt;
-    TreeNode *elseStmt = NULL;
+            break;
 
+        case BeginCompound:
 
-    DEBUG_ONLY( fprintf(listing, "*** Entered selection_statement()\n"); )
+            DEBUG_ONLY( fprintf(listing, "*** Entered compound_statement()\n"); )
 
-    match(IF);
-    match(LPAREN);
-    expr = expression();
-    match(RPAREN);
-    ifStmt = statement();
+            enterStatement();
+            match(LBRACE);
+            step = EndStatement;
+            tree = NULL;
 
-    if (token == ELSE)
-    {
-        match(ELSE);
-        elseStmt = statement();
-    }
+            if ((token != RBRACE) && (tree = newStmtNode(CompoundK)))
+            {
+                if (isAType(token))
+                    tree->child[0] = nodeIndex(local_declarations());
+
+                if (token != RBRACE)
+                {
+                    DEBUG_ONLY( fprintf(listing, "*** Entered statement_list()\n"); )
+
+                    frame = pushFrame(InStatementList);
+                    frame->tree = tree;
+                    step = BeginStatement;
+                    break;
+                }
+            }
 
-    tree = newStmtNode(IfK);
-    if (tree != NULL)
-    {
-        tree->child[0] = expr;
-        tree->child[1] = ifStmt;
-        tree->child[2] = elseStmt;
-    }
+            match(RBRACE);
+            --statementDepth;
 
-    return tree;
-}
+            DEBUG_ONLY( fprintf(listing, "*** Exiting compound_statement()\n"); )
 
+            break;
 
-static TreeNode *iteration_statement(void)
-{
-    TreeNode *tree;
-    TreeNode *expr;
-    TreeNode *stmt;
+        case EndStatement:
 
+            /* "tree" is finished; hand it to whatever it's part of */
+            if (frameCount == 0)
+                return tree;
 
-    DEBUG_ONLY( fprintf(listing, "*** Entered iteration_statement()\n"); )
+            frame = &frames[frameCount - 1];
 
-    match(WHILE);
-    match(LPAREN);
-    expr = expression();
-    match(RPAREN);
-    stmt = statement();
+            switch (frame->kind)
+            {
+            case InStatement:
+                DEBUG_ONLY( fprintf(listing, "*** Exiting statement()\n"); )
+
+                --frameCount;
+                break;
+
+            case InThenPart:
+                frame->first = tree;
+
+                if (token == ELSE)
+                {
+                    match(ELSE);
+                    frame->kind = InElsePart;
+                    step = BeginStatement;
+                    break;
+                }
+
+                tree = NULL;   /* no else-part */
+
+                /* FALLTHROUGH */
+
+            case InElsePart:
+                newNode = newStmtNode(IfK);
+                if (newNode != NULL)
+                {
+                    newNode->child[0] = nodeIndex(frame->tree);
+                    newNode->child[1] = nodeIndex(frame->first);
+                    newNode->child[2] = nodeIndex(tree);
+                }
+
+                tree = newNode;
+                --frameCount;
+                --statementDepth;
+                break;
+
+            case InWhileBody:
+                newNode = newStmtNode(WhileK);
+                if (newNode != NULL)
+                {
+                    newNode->child[0] = nodeIndex(frame->tree);
+                    newNode->child[1] = nodeIndex(tree);
+                }
+
+                tree = newNode;
+                --frameCount;
+                --statementDepth;
+                break;
+
+            case InStatementList:
+                if (!frame->gotFirst)
+                {
+                    frame->first = frame->last = tree;
+                    frame->gotFirst = TRUE;
+                }
+                else if ((frame->last != NULL) && (tree != NULL))
+                {
+                    frame->last->sibling = nodeIndex(tree);
+                    frame->last = tree;
+                }
+
+                if ((token != RBRACE) && (token != ENDOFFILE))
+                {
+                    step = BeginStatement;
+                    break;
+                }
+
+                DEBUG_ONLY( fprintf(listing, "*** Exiting statement_list()\n"); )
+
+                tree = frame->tree;
+                tree->child[1] = nodeIndex(frame->first);
+                --frameCount;
+
+                match(RBRACE);
+                --statementDepth;
+
+                DEBUG_ONLY( fprintf(listing, "*** Exiting compound_statement()\n"); )
+
+                break;
+            }
 
-    tree = newStmtNode(WhileK);
-    if (tree != NULL)
+            break;
+        }
+    }
+}
+
+
+static TreeNode *expression_statement(void)
+{
+    TreeNode *tree = NULL;
+
+    DEBUG_ONLY( fprintf(listing, "*** Entered expression_statement()\n"); )
+
+    if (token == SEMI)
+        match(SEMI);
+    else if (token != RBRACE)
     {
-        tree->child[0] = expr;
-        tree->child[1] = stmt;
+        tree = expression();
+        match(SEMI);
     }
 
+    DEBUG_ONLY( fprintf(listing, "*** Exiting expression_statement()\n"); )
+
     return tree;
 }
 
@@ -551,7 +652,7 @@ static TreeNode *return_statement(void)
         expr = expression();
 
     if (tree != NULL)
-        tree->child[0] = expr;
+        tree->child[0] = nodeIndex(expr);
 
     match(SEMI);
 
@@ -559,6 +660,46 @@ static TreeNode *return_statement(void)
 }
 
 
+/*
+ * Expressions still nest by recursion (a few calls for each level of
+ *  brackets, subscripts, arguments or assignments), and the passes after
+ *  this one recurse over the trees they make, so there's a limit on how
+ *  deep an expression may be.  Each expression() counts one level, and so
+ *  does each operator of a chain like "a + b + c", which binary_expression()
+ *  parses in a loop but which still makes a tree one level taller per
+ *  operator.  An expression any deeper is skipped to the end of its own
+ *  level: up to the bracket that closes it, or to the end of the statement.
+ */
+
+static int expressionDepth = 0;
+
+static void skipNestedExpression(void)
+{
+    char message[80];
+    int  brackets = 0;    /* brackets opened while skipping */
+
+    sprintf(message, "expression more than %d levels deep\n", NestingLimit);
+    syntaxError(message);
+
+    while (token != ENDOFFILE)
+    {
+        if ((token == LPAREN) || (token == LSQUARE))
+            ++brackets;
+        else if ((token == RPAREN) || (token == RSQUARE))
+        {
+            if (brackets == 0)
+                break;
+            --brackets;
+        }
+        else if ((brackets == 0) && ((token == SEMI) || (token == COMMA)
+                                     || (token == LBRACE) || (token == RBRACE)))
+            break;
+
+        token = getToken();
+    }
+}
+
+
 static TreeNode *expression(void)
 {
     TreeNode *tree = NULL;
@@ -568,6 +709,14 @@ static TreeNode *expression(void)
 
     DEBUG_ONLY( fprintf(listing, "*** Entered expression()\n"); )
 
+    if (expressionDepth >= NestingLimit)
+    {
+        skipNestedExpression();
+        return NULL;
+    }
+
+    ++expressionDepth;
+
     /*
      *  At this point in the parse, we need to make a choice between
      *   parsing either an assignment or a simple-expression.
@@ -594,8 +743,8 @@ static TreeNode *expression(void)
             tree = newExpNode(AssignK);
             if (tree != NULL)
             {
-                tree->child[0] = lvalue;
-                tree->child[1] = rvalue;
+                tree->child[0] = nodeIndex(lvalue);
+                tree->child[1] = nodeIndex(rvalue);
             }
         }
         else
@@ -605,111 +754,107 @@ static TreeNode *expression(void)
         }
     }
     else
-        tree = simple_expression(lvalue);
+        tree = binary_expression(lvalue, 0);
+
+    --expressionDepth;
 
     return tree;
 }
 
 
-static TreeNode *simple_expression(TreeNode *passdown)
-{
-    TreeNode *tree;
-    TreeNode *lExpr = NULL;
-    TreeNode *rExpr = NULL;
-    TokenType operator;
+/*
+ * Binary expressions are parsed by precedence climbing, driven by the
+ *  binding powers below (indexed from PLUS to EQ, in the order they're
+ *  declared in TokenType; 0 means "not a binary operator").  This builds
+ *  the same trees as the old simple-expression/additive-expression/term/
+ *  factor chain, without a call per precedence level for every operand,
+ *  and runs of operators of the same precedence don't recurse at all.
+ */
 
-    DEBUG_ONLY( fprintf(listing, "*** Entered simple_expression()\n"); )
+#define RELATIONALPOWER      1     /* <= < > >= == != */
+#define ADDITIVEPOWER        2     /* + - */
+#define MULTIPLICATIVEPOWER  3     /* * / */
 
-    lExpr = additive_expression(passdown);
+static const unsigned char bindingPowers[EQ - PLUS + 1] =
+{
+    ADDITIVEPOWER,          /* PLUS   */
+    ADDITIVEPOWER,          /* MINUS  */
+    MULTIPLICATIVEPOWER,    /* TIMES  */
+    MULTIPLICATIVEPOWER,    /* DIVIDE */
+    RELATIONALPOWER,        /* LT     */
+    RELATIONALPOWER,        /* GT     */
+    0,                      /* ASSIGN */
+    RELATIONALPOWER,        /* NE     */
+    0, 0, 0, 0,             /* SEMI, COMMA, LPAREN, RPAREN     */
+    0, 0, 0, 0,             /* LSQUARE, RSQUARE, LBRACE, RBRACE */
+    RELATIONALPOWER,        /* LTE    */
+    RELATIONALPOWER,        /* GTE    */
+    RELATIONALPOWER         /* EQ     */
+};
+
+#define BINDINGPOWER(tok) \
+    ((((tok) >= PLUS) && ((tok) <= EQ)) ? bindingPowers[(tok) - PLUS] : 0)
+
+
+static TreeNode *binary_expression(TreeNode *passdown, int minPower)
+{
+    TreeNode  *tree;
+    TreeNode  *newNode;
+    TreeNode  *rExpr;
+    TokenType operator;
+    int       power;
+    int       levels = 0;   /* operators taken, each a level deeper */
 
-    if ((token == LTE) || (token == GTE) || (token == GT)
-            || (token == LT) || (token == EQ) || (token == NE))
+    /* If there's a subtree in "passdown", it's the leftmost operand. */
+    if (passdown != NULL)
     {
-        operator = token;
-        match(token);
-        rExpr = additive_expression(NULL);
-
-        tree = newExpNode(OpK);
-        if (tree != NULL)
-        {
-            tree->child[0] = lExpr;
-            tree->child[1] = rExpr;
-            tree->op = operator;
-        }
+        DEBUG_ONLY( fprintf(listing, ">>>   Returning passdown subtree\n"); )
+        tree = passdown;
     }
     else
-        tree = lExpr;
+        tree = factor();
 
-    return tree;
-}
-
-
-static TreeNode *additive_expression(TreeNode *passdown)
-{
-    TreeNode *tree;
-    TreeNode *newNode;
-
-    DEBUG_ONLY( fprintf(listing, "*** Entered additive_expression()\n"); )
-
-    tree = term(passdown);
-
-    while ((token == PLUS) || (token == MINUS))
+    /* take every operator that binds more tightly than our caller's */
+    while ((power = BINDINGPOWER(token)) > minPower)
     {
-        newNode = newExpNode(OpK);
-        if (newNode != NULL)
+        if (expressionDepth >= NestingLimit)
         {
-            newNode->child[0] = tree;
-            newNode->op = token;
-            tree = newNode;
-            match(token);
-            tree->child[1] = term(NULL);
+            skipNestedExpression();
+            break;
         }
-    }
-
-    return tree;
-}
-
+        ++expressionDepth;
+        ++levels;
 
-static TreeNode *term(TreeNode *passdown)
-{
-    TreeNode *tree;
-    TreeNode *newNode;
-
-    DEBUG_ONLY( fprintf(listing, "*** Entered term()\n"); )
-
-    tree = factor(passdown);
-
-    while ((token == TIMES) || (token == DIVIDE))
-    {
+        operator = token;
         newNode = newExpNode(OpK);
+        match(operator);
+
+        /* all the operators associate to the left */
+        rExpr = binary_expression(NULL, power);
 
         if (newNode != NULL)
         {
-            newNode->child[0] = tree;
-            newNode->op = token;
+            newNode->child[0] = nodeIndex(tree);
+            newNode->child[1] = nodeIndex(rExpr);
+            newNode->op = operator;
             tree = newNode;
-            match(token);
-            newNode->child[1] = factor(NULL);
         }
+
+        /* ...except the relational ones, which don't associate at all */
+        if (power == RELATIONALPOWER)
+            break;
     }
 
+    expressionDepth -= levels;
+
     return tree;
 }
 
 
-static TreeNode *factor(TreeNode *passdown)
+static TreeNode *factor(void)
 {
     TreeNode *tree = NULL;
 
-    DEBUG_ONLY( fprintf(listing, "*** Entered factor()\n"); )
-
-    /* If the subtree in "passdown" is a Factor, pass it back. */
-    if (passdown != NULL)
-    {
-        DEBUG_ONLY( fprintf(listing, ">>>   Returning passdown subtree\n"); )
-        return passdown;
-    }
-
     if (token == ID)
     {
         tree = ident_statement();
@@ -726,7 +871,6 @@ static TreeNode *factor(TreeNode *passdown)
         if (tree != NULL)
         {
             tree->val = atoi(tokenString);
-            tree->variableDataType = Integer;
         }
         match(NUM);
     }
@@ -753,7 +897,7 @@ static TreeNode *ident_statement(void)
     DEBUG_ONLY( fprintf(listing, "*** Entered ident_statement()\n"); )
 
     if (token == ID)
-        identifier = copyString(tokenString);
+        identifier = tokenSymbol;
     match(ID);
 
     if (token == LPAREN)
@@ -765,7 +909,7 @@ static TreeNode *ident_statement(void)
         tree = newStmtNode(CallK);
         if (tree != NULL)
         {
-            tree->child[0] = arguments;
+            tree->child[0] = nodeIndex(arguments);
             tree->name = identifier;
         }
     }
@@ -781,7 +925,7 @@ static TreeNode *ident_statement(void)
         tree = newExpNode(IdK);
         if (tree != NULL)
         {
-            tree->child[0] = expr;
+            tree->child[0] = nodeIndex(expr);
             tree->name = identifier;
         }
     }
@@ -821,7 +965,7 @@ static TreeNode *arg_list(void)
 
         if ((ptr != NULL) && (tree != NULL))
         {
-            ptr->sibling = newNode;
+            ptr->sibling = nodeIndex(newNode);
             ptr = newNode;
         }
     }
@@ -841,6 +985,11 @@ TreeNode *Parse(void)
     if (token != ENDOFFILE)
         syntaxError("Unexpected symbol at end of file\n");
 
+    /* compound_statement()'s stack is only needed while parsing */
+    free(frames);
+    frames = NULL;
+    frameCount = frameCapacity = 0;
+
     /* t points to the fully-constructed syntax tree */
     return t;
 }
@@ -2,7 +2,9 @@
 
 
 #include "Globals.h"
+#include "Intern.h"
 #include "Scan.h"
+#include "Thread.h"
 #include "Util.h"
 
 /* Uncomment this to enable fast reserved word scanning */
@@ -10,14 +12,117 @@
 /* #define FAST_RESERVED_WORDS */
 
 
-/* Definitions relevant to the operation to the scanner */
+/*
+ * Uncomment this to scan with the table-driven DFA instead of the
+ *  hand-written state machine.  Both produce the same token stream; the
+ *  switch is kept so their throughput can be compared.
+ */
+
+/* #define TABLE_DRIVEN_SCANNER */
+
+
+/*
+ * Runs of blanks and the bodies of comments are skipped 16 or 32 bytes at a
+ *  time with SSE2/AVX2 when the compiler targets them.  Uncomment this to
+ *  force the plain C fallback, which gives identical results.
+ */
+
+/* #define NO_SIMD_SCANNER */
+
+
+/*
+ * Uncomment this to have every parallel scan (see lexSource()) checked
+ *  against a serial scan of the same source, token by token.
+ */
+
+/* #define CHECK_PARALLEL_SCAN */
 
-#define BUFFERLENGTH 256
+#ifndef NO_SIMD_SCANNER
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_VECTOR_BYTES 32
+#elif defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define SCAN_VECTOR_BYTES 16
+#endif
+#endif
+
+#ifdef SCAN_VECTOR_BYTES
+#ifdef _MSC_VER
+#include <intrin.h>
+#define countBits(x)      ((int)__popcnt(x))
+static int lowestBit(unsigned int x)
+{
+    unsigned long index;
+
+    _BitScanForward(&index, x);
+    return (int)index;
+}
+#else
+#define countBits(x)      __builtin_popcount(x)
+#define lowestBit(x)      __builtin_ctz(x)
+#endif
+#endif
+
+
+/* Definitions relevant to the operation to the scanner */
 
-char lineText[BUFFERLENGTH];      /* text of the current line */
 char tokenString[MAXTOKENLEN+1];  /* lexeme of the current token */
-int  lineIndex = 0;               /* current position in this line */
-int  lineSize = 0;                /* size of the current line, in chars */
+char *tokenSymbol = NULL;         /* interned name, if the token is an ID */
+
+/*
+ * The whole source file is held in memory, and a scanner walks a pointer
+ *  over it.  "lineEnd" marks the end of the line that "pos" is in, so that
+ *  line numbering and source echoing still happen a line at a time.
+ *
+ *  Everything a scanner needs is kept in a ScanState, so that pieces of
+ *   the source can be scanned on several threads at once (see lexSource()).
+ *   scanToken() doesn't copy lexemes anywhere: it leaves the lexeme of the
+ *   token it scanned where it lies in the source, described by
+ *   "tokenStart" and "tokenLength".
+ */
+
+typedef struct
+{
+    const char *pos;          /* next character to be scanned        */
+    const char *end;          /* one past the last source character  */
+    const char *lineEnd;      /* one past the end of current line    */
+    int        line;          /* number of the current line          */
+    int        hitEOF;        /* has getNextChar() returned EOF?     */
+    const char *tokenStart;   /* first character of the lexeme       */
+    int        tokenLength;   /* number of characters in it          */
+} ScanState;
+
+static FileImage sourceImage;         /* the source file's contents */
+static ScanState scan;                /* the scanner getToken() uses */
+
+
+/*
+ * Scanned tokens are kept in a struct-of-arrays buffer, and getToken()
+ *  hands them out by index.  Normally the buffer only holds the tokens
+ *  that have been scanned ahead of the parser (see peekToken()); with
+ *  PreLexTokens set, lexSource() fills it with the whole file up front.
+ */
+
+typedef struct
+{
+    unsigned char *kind;      /* TokenType of each token             */
+    int           *offset;    /* where its lexeme starts in the source */
+    int           *length;    /* length of its lexeme                */
+    int           *line;      /* lineno when it had been scanned     */
+    int           count;      /* number of tokens in the buffer      */
+    int           capacity;   /* number of tokens there's room for   */
+} TokenBuffer;
+
+static TokenBuffer tokens;            /* the scanned tokens            */
+static int         nextToken = 0;     /* index of the next to hand out */
+
+
+/* Function prototypes for module statics */
+
+static void startScanner(ScanState *s, const char *from);
+static void freeTokens(TokenBuffer *buffer);
 
 /* Here are the various state that the lexer DFSA can be in */
 
@@ -28,6 +133,43 @@ typedef enum
 } LexerState;
 
 
+#ifdef TABLE_DRIVEN_SCANNER
+
+/* Character classes used by the table-driven scanner */
+
+typedef enum
+{
+    CC_DIGIT, CC_LETTER, CC_SLASH, CC_STAR, CC_BANG, CC_LT, CC_GT, CC_EQ,
+    CC_BLANK, CC_SINGLE, CC_OTHER, CC_EOF, NUMCLASSES
+} CharClass;
+
+/* What to do with the character that caused a move */
+
+typedef enum
+{
+    DROP_CHAR,      /* throw it away                        */
+    SAVE_CHAR,      /* it's part of the lexeme              */
+    UNGET_CHAR,     /* push it back for the next token      */
+    RESTART_TOKEN   /* drop the lexeme so far (comment "/") */
+} ScanAction;
+
+/* Marks a move whose token depends on the character (see singleCharTokens) */
+#define SINGLE_CHAR_TOKEN 255
+
+typedef struct
+{
+    unsigned char next;     /* LexerState to move to              */
+    unsigned char token;    /* TokenType recognised if next==DONE */
+    unsigned char action;   /* ScanAction for this character      */
+} Transition;
+
+static unsigned char charClass[256];
+static unsigned char singleCharTokens[256];
+static Transition    transitionTable[DONE][NUMCLASSES];
+
+#endif /* TABLE_DRIVEN_SCANNER */
+
+
 /*
  * Here are the language reserved words, together with their corresponding
  *  tokens.
@@ -128,7 +270,7 @@ register unsigned int len;
         {
             register const char *s = wordlist[key].name;
 
-            if (*str == *s && !strcmp (str + 1, s + 1))
+            if (*str == *s && !strncmp (str + 1, s + 1, len - 1) && s[len] == '\0')
                 return &wordlist[key];
         }
     }
@@ -143,17 +285,18 @@ register unsigned int len;
  * PURPOSE:  Looks up identifiers to check to see if they're reserved words.
  *
  *  If the routine finds a match, the corresponding token is returned, else
- *   the token "ID" is returned instead.
+ *   the token "ID" is returned instead.  The lexeme need not be
+ *   null-terminated.
  */
 
 
-TokenType LookupReservedWord(char *lexeme)
+TokenType LookupReservedWord(const char *lexeme, int length)
 {
 #ifdef FAST_RESERVED_WORDS
 
     struct fastReservedWords *rWord;
 
-    rWord = in_word_set(lexeme, strlen(lexeme));
+    rWord = in_word_set(lexeme, length);
 
     if (rWord)
         return (rWord->tok);
@@ -166,7 +309,8 @@ TokenType LookupReservedWord(char *lexeme)
 
     for (i=0; i<MAXRESERVED; ++i)
     {
-        if (!strcmp(lexeme, reservedWords[i]))
+        if ((!strncmp(lexeme, reservedWords[i], length))
+                && (reservedWords[i][length] == '\0'))
             return reservedWordsTokens[i];
     }
 
@@ -175,8 +319,170 @@ TokenType LookupReservedWord(char *lexeme)
 }
 
 
+#ifdef TABLE_DRIVEN_SCANNER
+
+/*
+ * NAME:     setMove()
+ * PURPOSE:  Fills in one entry of the scanner's transition table.
+ */
+
+static void setMove(LexerState state, CharClass cls, LexerState next,
+                    int token, ScanAction action)
+{
+    transitionTable[state][cls].next = (unsigned char)next;
+    transitionTable[state][cls].token = (unsigned char)token;
+    transitionTable[state][cls].action = (unsigned char)action;
+}
+
+
+/*
+ * NAME:     buildScannerTables()
+ * PURPOSE:  Builds the character-class and transition tables that drive
+ *            the table-driven scanner.  Each state's moves mirror the
+ *            corresponding case in the hand-written scanner.
+ */
+
+static void buildScannerTables(void)
+{
+    static const char singles[] = "+-*;,[](){}";
+    static const TokenType singleTokens[] =
+    {
+        PLUS, MINUS, TIMES, SEMI, COMMA, LSQUARE, RSQUARE, LPAREN, RPAREN,
+        LBRACE, RBRACE
+    };
+
+    int c;
+    int cls;
+
+    /* classify every character */
+    for (c = 0; c < 256; ++c)
+    {
+        if (isdigit(c))
+            charClass[c] = CC_DIGIT;
+        else if (isalpha(c))
+            charClass[c] = CC_LETTER;
+        else
+            charClass[c] = CC_OTHER;
+    }
+
+    for (c = 0; singles[c] != '\0'; ++c)
+    {
+        charClass[(unsigned char)singles[c]] = CC_SINGLE;
+        singleCharTokens[(unsigned char)singles[c]] = singleTokens[c];
+    }
+
+    charClass['/'] = CC_SLASH;
+    charClass['*'] = CC_STAR;
+    charClass['!'] = CC_BANG;
+    charClass['<'] = CC_LT;
+    charClass['>'] = CC_GT;
+    charClass['='] = CC_EQ;
+    charClass[' '] = charClass['\t'] = charClass['\n'] = CC_BLANK;
+
+    singleCharTokens['*'] = TIMES;
+
+    /* START: begin a multi-character token, skip blanks, or finish */
+    for (cls = 0; cls < NUMCLASSES; ++cls)
+        setMove(START, cls, DONE, ERROR, SAVE_CHAR);
+
+    setMove(START, CC_DIGIT, INNUM, ERROR, SAVE_CHAR);
+    setMove(START, CC_LETTER, INID, ERROR, SAVE_CHAR);
+    setMove(START, CC_SLASH, INDIV, ERROR, SAVE_CHAR);
+    setMove(START, CC_BANG, INNE, ERROR, SAVE_CHAR);
+    setMove(START, CC_LT, INLT, ERROR, SAVE_CHAR);
+    setMove(START, CC_GT, INGT, ERROR, SAVE_CHAR);
+    setMove(START, CC_EQ, INEQ, ERROR, SAVE_CHAR);
+    setMove(START, CC_BLANK, START, ERROR, DROP_CHAR);
+    setMove(START, CC_STAR, DONE, SINGLE_CHAR_TOKEN, SAVE_CHAR);
+    setMove(START, CC_SINGLE, DONE, SINGLE_CHAR_TOKEN, SAVE_CHAR);
+    setMove(START, CC_EOF, DONE, ENDOFFILE, DROP_CHAR);
+
+    /* the "x=" operators: anything but "=" is pushed back */
+    for (cls = 0; cls < NUMCLASSES; ++cls)
+    {
+        setMove(INNE, cls, DONE, ERROR, UNGET_CHAR);
+        setMove(INLT, cls, DONE, LT, UNGET_CHAR);
+        setMove(INGT, cls, DONE, GT, UNGET_CHAR);
+        setMove(INEQ, cls, DONE, ASSIGN, UNGET_CHAR);
+    }
+
+    setMove(INNE, CC_EQ, DONE, NE, SAVE_CHAR);
+    setMove(INLT, CC_EQ, DONE, LTE, SAVE_CHAR);
+    setMove(INGT, CC_EQ, DONE, GTE, SAVE_CHAR);
+    setMove(INEQ, CC_EQ, DONE, EQ, SAVE_CHAR);
+
+    /* division, or the start of a comment */
+    for (cls = 0; cls < NUMCLASSES; ++cls)
+        setMove(INDIV, cls, DONE, DIVIDE, UNGET_CHAR);
+
+    setMove(INDIV, CC_STAR, INCOMMENT, ERROR, RESTART_TOKEN);
+
+    /* inside a comment, and after a "*" inside a comment */
+    for (cls = 0; cls < NUMCLASSES; ++cls)
+    {
+        setMove(INCOMMENT, cls, INCOMMENT, ERROR, DROP_CHAR);
+        setMove(INCOMMENT2, cls, INCOMMENT, ERROR, DROP_CHAR);
+    }
+
+    setMove(INCOMMENT, CC_STAR, INCOMMENT2, ERROR, DROP_CHAR);
+    setMove(INCOMMENT, CC_EOF, DONE, ERROR, RESTART_TOKEN);
+    setMove(INCOMMENT2, CC_STAR, INCOMMENT2, ERROR, DROP_CHAR);
+    setMove(INCOMMENT2, CC_SLASH, START, ERROR, DROP_CHAR);
+
+    /* identifiers and numbers */
+    for (cls = 0; cls < NUMCLASSES; ++cls)
+    {
+        setMove(INID, cls, DONE, ID, UNGET_CHAR);
+        setMove(INNUM, cls, DONE, NUM, UNGET_CHAR);
+    }
+
+    setMove(INID, CC_LETTER, INID, ERROR, SAVE_CHAR);
+    setMove(INNUM, CC_DIGIT, INNUM, ERROR, SAVE_CHAR);
+}
+
+#endif /* TABLE_DRIVEN_SCANNER */
+
+
+/*
+ * NAME:     initScanner()
+ * PURPOSE:  Loads the source file into memory ready for scanning.
+ */
+
+int initScanner(void)
+{
+    if (!loadFileImage(source, &sourceImage))
+    {
+        fprintf(listing, "*** Unable to read the source file.\n");
+        return FALSE;
+    }
+
+    startScanner(&scan, sourceImage.text);
+
+#ifdef TABLE_DRIVEN_SCANNER
+    buildScannerTables();
+#endif
+
+    return TRUE;
+}
+
+
 /*
- * NANE:    getNextChar()
+ * NAME:     releaseScanner()
+ * PURPOSE:  Releases the in-memory copy of the source file.
+ */
+
+void releaseScanner(void)
+{
+    releaseFileImage(&sourceImage);
+    memset(&scan, 0, sizeof(scan));
+
+    freeTokens(&tokens);
+    nextToken = 0;
+}
+
+
+/*
+ * NANE:    getNextChar(s)
  * PURPOSE: Returns the next character from the source file.
  *
  *  The reader will note that this code, and the "lookahead" mechanism
@@ -186,47 +492,272 @@ TokenType LookupReservedWord(char *lexeme)
  *  Louden's code is as good as it gets, so I'd be wasting my time
  *   reinventing the wheel.  Therefore, some snippets of code are
  *   borrowed from Louden.
+ *
+ *  The source lives in memory, so there is no per-line copy and no limit
+ *   on line length; we only stop at line boundaries to bump the line
+ *   number and echo the new line.
  */
 
-static char getNextChar()
+static int getNextChar(ScanState *s)
 {
-    /* Have we run out of characters? */
-    if (lineIndex >= lineSize)
+    /* Have we run out of characters on this line? */
+    if (s->pos >= s->lineEnd)
     {
-        ++lineno;
+        ++s->line;
 
-        /* get a new line and return a character */
-        if (fgets(lineText, BUFFERLENGTH-1, source))
+        if (s->pos >= s->end)
         {
-            lineSize = strlen(lineText);
-            lineIndex = 0;
+            s->hitEOF = TRUE;
+            return EOF;
+        }
 
-            /*
-             * If EchoSource is TRUE, we need to display source lines to
-             *  standard output.
-             */
-            if (EchoSource)
-                fprintf(listing, "SOURCE: %5d: %s", lineno, lineText);
+        /* find the end of the new line */
+        s->lineEnd = (const char*)memchr(s->pos, '\n', s->end - s->pos);
+        s->lineEnd = (s->lineEnd == NULL) ? s->end : s->lineEnd + 1;
+
+        /*
+         * If EchoSource is TRUE, we need to display source lines to
+         *  standard output.
+         */
+        if (EchoSource)
+            fprintf(listing, "SOURCE: %5d: %.*s", s->line,
+                    (int)(s->lineEnd - s->pos), s->pos);
+    }
+
+    return (unsigned char)*s->pos++;
+}
+
+
+static void ungetNextChar(ScanState *s)
+{
+    /* there's nothing to put back once we've run off the end */
+    if (!s->hitEOF)
+        --s->pos;
+}
+
+
+/*
+ * NAME:     skipBlanks()
+ * PURPOSE:  Returns the first character at or after "p" that isn't a blank,
+ *            adding the number of newlines passed over to "*newlines".
+ */
+
+static const char *skipBlanks(const char *p, const char *end, int *newlines)
+{
+#if SCAN_VECTOR_BYTES == 32
+    const __m256i spaces = _mm256_set1_epi8(' ');
+    const __m256i tabs = _mm256_set1_epi8('\t');
+    const __m256i nls = _mm256_set1_epi8('\n');
+
+    while (end - p >= 32)
+    {
+        __m256i      text = _mm256_loadu_si256((const __m256i*)p);
+        __m256i      nl = _mm256_cmpeq_epi8(text, nls);
+        unsigned int nlMask = (unsigned int)_mm256_movemask_epi8(nl);
+        unsigned int blankMask = (unsigned int)_mm256_movemask_epi8(
+            _mm256_or_si256(nl, _mm256_or_si256(
+                _mm256_cmpeq_epi8(text, spaces),
+                _mm256_cmpeq_epi8(text, tabs))));
+
+        if (blankMask != 0xFFFFFFFFu)
+        {
+            int stop = lowestBit(~blankMask);
 
-            return lineText[lineIndex++];
+            *newlines += countBits(nlMask & ((1u << stop) - 1));
+            return p + stop;
         }
-        else
-            return EOF;
+
+        *newlines += countBits(nlMask);
+        p += 32;
+    }
+#elif SCAN_VECTOR_BYTES == 16
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i tabs = _mm_set1_epi8('\t');
+    const __m128i nls = _mm_set1_epi8('\n');
+
+    while (end - p >= 16)
+    {
+        __m128i      text = _mm_loadu_si128((const __m128i*)p);
+        __m128i      nl = _mm_cmpeq_epi8(text, nls);
+        unsigned int nlMask = (unsigned int)_mm_movemask_epi8(nl);
+        unsigned int blankMask = (unsigned int)_mm_movemask_epi8(
+            _mm_or_si128(nl, _mm_or_si128(_mm_cmpeq_epi8(text, spaces),
+                                          _mm_cmpeq_epi8(text, tabs))));
+
+        if (blankMask != 0xFFFFu)
+        {
+            int stop = lowestBit(~blankMask);
+
+            *newlines += countBits(nlMask & ((1u << stop) - 1));
+            return p + stop;
+        }
+
+        *newlines += countBits(nlMask);
+        p += 16;
+    }
+#endif
+
+    /* scalar fallback, and the tail end of the source */
+    while ((p < end) && ((*p == ' ') || (*p == '\t') || (*p == '\n')))
+    {
+        if (*p == '\n')
+            ++*newlines;
+        ++p;
     }
 
-    return lineText[lineIndex++];
+    return p;
 }
 
 
-static void ungetNextChar()
+/*
+ * NAME:     skipCommentText()
+ * PURPOSE:  Returns the position of the first "*" at or after "p" that is
+ *            followed by a "/", adding the number of newlines passed over
+ *            to "*newlines".  If there is no such "*", the position of the
+ *            last character of the source is returned, so that the DFA
+ *            still sees it (and then EOF) exactly as it would have done.
+ */
+
+static const char *skipCommentText(const char *p, const char *end,
+                                   int *newlines)
 {
-    --lineIndex;
+#if SCAN_VECTOR_BYTES == 32
+    const __m256i stars = _mm256_set1_epi8('*');
+    const __m256i slashes = _mm256_set1_epi8('/');
+    const __m256i nls = _mm256_set1_epi8('\n');
+
+    /* compare each byte and its successor, so we need 33 bytes in hand */
+    while (end - p > 32)
+    {
+        __m256i      text = _mm256_loadu_si256((const __m256i*)p);
+        __m256i      next = _mm256_loadu_si256((const __m256i*)(p + 1));
+        unsigned int nlMask = (unsigned int)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(text, nls));
+        unsigned int closeMask = (unsigned int)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(text, stars),
+                             _mm256_cmpeq_epi8(next, slashes)));
+
+        if (closeMask != 0)
+        {
+            int stop = lowestBit(closeMask);
+
+            *newlines += countBits(nlMask & ((1u << stop) - 1));
+            return p + stop;
+        }
+
+        *newlines += countBits(nlMask);
+        p += 32;
+    }
+#elif SCAN_VECTOR_BYTES == 16
+    const __m128i stars = _mm_set1_epi8('*');
+    const __m128i slashes = _mm_set1_epi8('/');
+    const __m128i nls = _mm_set1_epi8('\n');
+
+    /* compare each byte and its successor, so we need 17 bytes in hand */
+    while (end - p > 16)
+    {
+        __m128i      text = _mm_loadu_si128((const __m128i*)p);
+        __m128i      next = _mm_loadu_si128((const __m128i*)(p + 1));
+        unsigned int nlMask = (unsigned int)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(text, nls));
+        unsigned int closeMask = (unsigned int)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(text, stars),
+                          _mm_cmpeq_epi8(next, slashes)));
+
+        if (closeMask != 0)
+        {
+            int stop = lowestBit(closeMask);
+
+            *newlines += countBits(nlMask & ((1u << stop) - 1));
+            return p + stop;
+        }
+
+        *newlines += countBits(nlMask);
+        p += 16;
+    }
+#endif
+
+    /* scalar fallback, and the tail end of the source */
+    while (end - p > 1)
+    {
+        if ((p[0] == '*') && (p[1] == '/'))
+            return p;
+        if (*p == '\n')
+            ++*newlines;
+        ++p;
+    }
+
+    return p;
 }
 
 
 /*
- * NAME:     getToken()
- * PURPOSE:  Returns the next token in the source file.
+ * NAME:     jumpTo()
+ * PURPOSE:  Moves scanner "s" forward to "target", given that "newlines"
+ *            newline characters lie between here and there.
+ *
+ *  The line containing "target" is treated as though it starts there, so
+ *   that the next getNextChar() bumps the line number onto it.  That is
+ *   only safe when source lines aren't being echoed, so callers check
+ *   EchoSource.
+ */
+
+static void jumpTo(ScanState *s, const char *target, int newlines)
+{
+    /* if a new line was already due, we're passing over one more */
+    if (s->pos >= s->lineEnd)
+        ++newlines;
+
+    if (newlines > 0)
+    {
+        s->line += newlines - 1;
+        s->lineEnd = target;
+    }
+
+    s->pos = target;
+}
+
+
+/*
+ * NAME:     skipBlankRun()
+ * PURPOSE:  Skips the rest of a run of blanks the scanner has just entered.
+ */
+
+static void skipBlankRun(ScanState *s)
+{
+    const char *target;
+    int        newlines = 0;
+
+    if ((s->pos < s->end) && ((*s->pos == ' ')
+            || (*s->pos == '\t') || (*s->pos == '\n')))
+    {
+        target = skipBlanks(s->pos, s->end, &newlines);
+        jumpTo(s, target, newlines);
+    }
+}
+
+
+/*
+ * NAME:     skipCommentRun()
+ * PURPOSE:  Skips comment text up to the next "*" that closes the comment.
+ */
+
+static void skipCommentRun(ScanState *s)
+{
+    const char *target;
+    int        newlines = 0;
+
+    target = skipCommentText(s->pos, s->end, &newlines);
+    jumpTo(s, target, newlines);
+}
+
+
+#ifndef TABLE_DRIVEN_SCANNER
+
+/*
+ * NAME:     scanToken()
+ * PURPOSE:  Scans the next token with scanner "s", and leaves its lexeme
+ *            described by s->tokenStart and s->tokenLength.
  *
  *  This stuff here is mostly my code.  It tokenises valid C- source
  *   files (rather than Tiny C, like Louden's) and sports a minor
@@ -235,20 +766,21 @@ static void ungetNextChar()
  *   words.
  */
 
-TokenType getToken(void)
+static TokenType scanToken(ScanState *s)
 {
-    int        tokenIndex = 0;   /* index into tokenString    */
     TokenType  currentToken;     /* token to be returned      */
     LexerState state = START;    /* FSA state                 */
-    int        save;             /* save char to tokenString? */
 
     int        c;             /* character under examination */
 
 
     while (state != DONE)
     {
-        c = getNextChar();
-        save = TRUE;      /* save this character into lexeme by default */
+        /* until we've left START, the lexeme begins at the next char */
+        if (state == START)
+            s->tokenStart = s->pos;
+
+        c = getNextChar(s);
 
         switch(state)
         {
@@ -268,7 +800,10 @@ TokenType getToken(void)
             else if (c == '=')
                 state = INEQ;
             else if ((c == '\n') || (c == '\t') || (c == ' '))
-                save = FALSE;
+            {
+                if (!EchoSource)
+                    skipBlankRun(s);
+            }
             else
             {
                 /*
@@ -279,7 +814,6 @@ TokenType getToken(void)
                 switch (c)
                 {
                 case EOF:
-                    save = FALSE;
                     currentToken = ENDOFFILE;
                     break;
                 case '+':
@@ -331,8 +865,7 @@ TokenType getToken(void)
             else
             {
                 /* back up in the input */
-                ungetNextChar();
-                save = FALSE;
+                ungetNextChar(s);
                 currentToken = ERROR;
             }
             break;
@@ -348,8 +881,7 @@ TokenType getToken(void)
                  * Ok, we haven't scanned a <= symbol: put the next char
                  *  back for the next token
                  */
-                ungetNextChar();
-                save = FALSE;
+                ungetNextChar(s);
                 currentToken = LT;
             }
             break;
@@ -365,8 +897,7 @@ TokenType getToken(void)
                  * Ok, we haven't scanned a >= symbol: put the next char
                  *  back for the next token
                  */
-                ungetNextChar();
-                save = FALSE;
+                ungetNextChar(s);
                 currentToken = GT;
             }
             break;
@@ -382,8 +913,7 @@ TokenType getToken(void)
                  * Ok, we haven't scanned a <= symbol: put the next char
                  *  back for the next token
                  */
-                ungetNextChar();
-                save = FALSE;
+                ungetNextChar(s);
                 currentToken = ASSIGN;
             }
             break;
@@ -391,22 +921,19 @@ TokenType getToken(void)
         case INDIV:
             if (c == '*')
             {
-                save = FALSE;
                 state = INCOMMENT;
-                tokenIndex -=1;     /* remove "/" from tokenString */
+                if (!EchoSource)
+                    skipCommentRun(s);
             }
             else
             {
-                ungetNextChar();
-                save = FALSE;
+                ungetNextChar(s);
                 state = DONE;
                 currentToken = DIVIDE;
             }
             break;
 
         case INCOMMENT:
-            save = FALSE;
-
             if (c == '*')
                 state = INCOMMENT2;
 
@@ -416,13 +943,15 @@ TokenType getToken(void)
              */
 
             else if (c == EOF)
-                state = ERROR;
+            {
+                state = DONE;
+                currentToken = ERROR;
+                s->tokenStart = s->pos;   /* the comment isn't the lexeme */
+            }
 
             break;
 
         case INCOMMENT2:
-            save = FALSE;
-
             if (c == '/')
                 state = START;
             /*
@@ -434,15 +963,18 @@ TokenType getToken(void)
             else if (c == '*')
                 state = INCOMMENT2;  /* no change */
             else
+            {
                 state = INCOMMENT;
+                if (!EchoSource)
+                    skipCommentRun(s);
+            }
             break;
 
         case INID:
             if (!isalpha(c))
             {
                 /* back up */
-                ungetNextChar();
-                save = FALSE;
+                ungetNextChar(s);
                 state = DONE;
                 currentToken = ID;
             }
@@ -453,8 +985,7 @@ TokenType getToken(void)
             if (!isdigit(c))
             {
                 /* back up */
-                ungetNextChar();
-                save = FALSE;
+                ungetNextChar(s);
                 state = DONE;
                 currentToken = NUM;
             }
@@ -468,21 +999,571 @@ TokenType getToken(void)
             break;
         }  /* switch(state) */
 
+    }  /* while (state != DONE) */
 
-        /* Append a character onto the tokenString (if it was asked for) */
-        if ((save) && (tokenIndex <= MAXTOKENLEN))
-            tokenString[tokenIndex++] = c;
+    /* the lexeme runs up to (but not including) any pushed-back char */
+    s->tokenLength = (int)(s->pos - s->tokenStart);
 
-        if (state == DONE)
+    if (currentToken == ID)
+        currentToken = LookupReservedWord(s->tokenStart, s->tokenLength);
+
+    return currentToken;
+}
+
+#else /* TABLE_DRIVEN_SCANNER */
+
+/*
+ * NAME:     scanToken()
+ * PURPOSE:  Scans the next token with scanner "s", and leaves its lexeme
+ *            described by s->tokenStart and s->tokenLength.
+ *
+ *  This is the same DFA as the hand-written scanner, but driven by a pair
+ *   of tables built by buildScannerTables(): one maps each character onto
+ *   a character class, the other gives the move for each (state, class)
+ *   pair.  Characters are fetched straight from the source image, and we
+ *   only call getNextChar() when we cross a line boundary.
+ */
+
+static TokenType scanToken(ScanState *s)
+{
+    int              state = START;    /* FSA state              */
+    int              c;                /* character under examination */
+    const Transition *move;            /* move taken on "c"      */
+    TokenType        currentToken;     /* token to be returned   */
+
+    do
+    {
+        /* until we've left START, the lexeme begins at the next char */
+        if (state == START)
+            s->tokenStart = s->pos;
+
+        c = (s->pos < s->lineEnd) ? (unsigned char)*s->pos++
+                                   : getNextChar(s);
+
+        move = &transitionTable[state][(c == EOF) ? CC_EOF : charClass[c]];
+
+        if (move->action == UNGET_CHAR)
+            ungetNextChar(s);
+        else if (move->action == RESTART_TOKEN)
+            s->tokenStart = s->pos;
+
+        state = move->next;
+
+        /* skip whole runs of blanks and comment text in one go */
+        if ((move->action != SAVE_CHAR) && (!EchoSource))
         {
-            /* null-terminate the string */
-            tokenString[tokenIndex] = '\0';
+            if ((state == START) && (c != '/'))
+                skipBlankRun(s);
+            else if (state == INCOMMENT)
+                skipCommentRun(s);
+        }
+    }
+    while (state != DONE);
+
+    /* the lexeme runs up to (but not including) any pushed-back char */
+    s->tokenLength = (int)(s->pos - s->tokenStart);
+
+    if (move->token == SINGLE_CHAR_TOKEN)
+        currentToken = (TokenType)singleCharTokens[c];
+    else
+        currentToken = (TokenType)move->token;
+
+    if (currentToken == ID)
+        currentToken = LookupReservedWord(s->tokenStart, s->tokenLength);
+
+    return currentToken;
+}
+
+#endif /* TABLE_DRIVEN_SCANNER */
+
+
+/*
+ * NAME:     reserveTokens()
+ * PURPOSE:  Makes sure that "buffer" has room for "needed" tokens.
+ */
+
+static void reserveTokens(TokenBuffer *buffer, int needed)
+{
+    int newCapacity;
+
+    if (needed <= buffer->capacity)
+        return;
+
+    newCapacity = (buffer->capacity == 0) ? 64 : buffer->capacity;
+    while (newCapacity < needed)
+        newCapacity *= 2;
+
+    buffer->kind = (unsigned char*)realloc(buffer->kind,
+                                           newCapacity * sizeof(*buffer->kind));
+    buffer->offset = (int*)realloc(buffer->offset,
+                                   newCapacity * sizeof(*buffer->offset));
+    buffer->length = (int*)realloc(buffer->length,
+                                   newCapacity * sizeof(*buffer->length));
+    buffer->line = (int*)realloc(buffer->line,
+                                 newCapacity * sizeof(*buffer->line));
+
+    if ((buffer->kind == NULL) || (buffer->offset == NULL)
+            || (buffer->length == NULL) || (buffer->line == NULL))
+    {
+        fprintf(listing, "*** Out of memory while scanning the source.\n");
+        exit(1);
+    }
+
+    buffer->capacity = newCapacity;
+}
+
+
+/*
+ * NAME:     addToken()
+ * PURPOSE:  Adds a token onto the end of "buffer".
+ */
+
+static void addToken(TokenBuffer *buffer, TokenType kind, int offset,
+                     int length, int line)
+{
+    if (buffer->count == buffer->capacity)
+        reserveTokens(buffer, buffer->count + 1);
+
+    buffer->kind[buffer->count] = (unsigned char)kind;
+    buffer->offset[buffer->count] = offset;
+    buffer->length[buffer->count] = length;
+    buffer->line[buffer->count] = line;
+    ++buffer->count;
+}
+
+
+/*
+ * NAME:     freeTokens()
+ * PURPOSE:  Releases the arrays of "buffer" and empties it.
+ */
+
+static void freeTokens(TokenBuffer *buffer)
+{
+    free(buffer->kind);
+    free(buffer->offset);
+    free(buffer->length);
+    free(buffer->line);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+
+/*
+ * NAME:     startScanner()
+ * PURPOSE:  Sets up scanner "s" to start scanning at "from", as though
+ *            it were the start of the source file.
+ */
+
+static void startScanner(ScanState *s, const char *from)
+{
+    s->pos = from;
+    s->end = sourceImage.text + sourceImage.length;
+    s->lineEnd = from;
+    s->line = 0;
+    s->hitEOF = FALSE;
+    s->tokenStart = from;
+    s->tokenLength = 0;
+}
+
+
+/*
+ * NAME:     scanIntoBuffer()
+ * PURPOSE:  Scans one more token onto the end of the token buffer.
+ */
+
+static void scanIntoBuffer(void)
+{
+    TokenType token;
+
+    token = scanToken(&scan);
+    addToken(&tokens, token, (int)(scan.tokenStart - sourceImage.text),
+             scan.tokenLength, scan.line);
+}
+
+
+/*
+ * Parallel scanning.  The source is cut into chunks at line starts, and
+ *  each chunk is scanned on a thread of its own, by a scanner that starts
+ *  there as though it were the start of the file.
+ *
+ *  A chunk's scanner carries on past the end of its chunk until it has
+ *   scanned a token that starts beyond it, so that tokens straddling a
+ *   seam are scanned whole.  If a cut happens to fall inside a comment,
+ *   the next chunk's scanner starts off out of step with the real token
+ *   stream.  So when the chunks are stitched together, the scanner of the
+ *   chunk before a seam keeps going until it scans a token that the next
+ *   chunk's scanner also found: the same kind of token, starting at the
+ *   same place.  Both scanners were then in the START state at the same
+ *   character, so from there on the next chunk's tokens can be taken as
+ *   they stand.
+ *
+ *  A token's line number only depends on where it is, so each chunk's
+ *   line numbers (which count from the start of the chunk) are fixed up
+ *   by adding the number of newlines before the chunk.
+ */
+
+#define MINCHUNKSIZE (256 * 1024)     /* smallest chunk worth a thread */
+
+typedef struct
+{
+    const char  *start;       /* first character of the chunk        */
+    const char  *stop;        /* one past its last character         */
+    ScanState   state;        /* the chunk's scanner                 */
+    TokenBuffer tokens;       /* its tokens, lines counted from start */
+    int         newlines;     /* number of newlines in the chunk     */
+    int         lineBase;     /* number of newlines before the chunk */
+    FILE        *listing;     /* where its thread reports trouble    */
+} ScanChunk;
+
+
+/*
+ * NAME:     lexChunk()
+ * PURPOSE:  Scans one chunk of the source (on a thread of its own), up to
+ *            and including the first token that starts beyond it.
+ */
+
+static void lexChunk(void *item)
+{
+    ScanChunk  *chunk = (ScanChunk*)item;
+    const char *p = chunk->start;
+    TokenType  token;
+
+    /* each thread has its own listing file */
+    listing = chunk->listing;
+
+    /* count the chunk's newlines for the line number fix-up */
+    while ((p = (const char*)memchr(p, '\n', chunk->stop - p)) != NULL)
+    {
+        ++chunk->newlines;
+        ++p;
+    }
+
+    /* C- source runs to about one token in every five characters */
+    reserveTokens(&chunk->tokens, (int)((chunk->stop - chunk->start) / 5) + 1);
+
+    startScanner(&chunk->state, chunk->start);
+
+    do
+    {
+        token = scanToken(&chunk->state);
+        addToken(&chunk->tokens, token,
+                 (int)(chunk->state.tokenStart - sourceImage.text),
+                 chunk->state.tokenLength, chunk->state.line);
+    }
+    while ((token != ENDOFFILE) && (chunk->state.tokenStart < chunk->stop));
+}
+
+
+/*
+ * NAME:     findToken()
+ * PURPOSE:  Returns the index of the token of kind "kind" starting at
+ *            "offset" in "buffer", or -1 if there isn't one.
+ */
+
+static int findToken(const TokenBuffer *buffer, TokenType kind, int offset)
+{
+    int low = 0, high = buffer->count;
+    int middle;
+
+    /* tokens are in order of where they start, so binary search */
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+
+        if (buffer->offset[middle] < offset)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    /* only the tokens at the very end of the file share a start */
+    for ( ; (low < buffer->count) && (buffer->offset[low] == offset); ++low)
+    {
+        if (buffer->kind[low] == kind)
+            return low;
+    }
+
+    return -1;
+}
+
+
+/*
+ * NAME:     stitchChunks()
+ * PURPOSE:  Joins the tokens of the scanned chunks together into the
+ *            token buffer, fixing up their line numbers.
+ */
 
-            if (currentToken == ID)
-                currentToken = LookupReservedWord(tokenString);
+static void stitchChunks(ScanChunk *chunks, int numChunks)
+{
+    ScanChunk *chunk = &chunks[0];     /* chunk whose tokens we're taking */
+    int       first = 0;               /* first of them to take           */
+    int       stop;                    /* offset of the end of the chunk  */
+    int       i, next, found;
+    TokenType kind;
+    int       offset, length, line;
+
+    for (;;)
+    {
+        /* take the chunk's tokens up to the first that starts beyond it */
+        stop = (int)(chunk->stop - sourceImage.text);
+
+        for (i=first; chunk->tokens.offset[i] < stop; ++i)
+            addToken(&tokens, (TokenType)chunk->tokens.kind[i],
+                     chunk->tokens.offset[i], chunk->tokens.length[i],
+                     chunk->tokens.line[i] + chunk->lineBase);
+
+        kind = (TokenType)chunk->tokens.kind[i];
+        offset = chunk->tokens.offset[i];
+        length = chunk->tokens.length[i];
+        line = chunk->tokens.line[i];
+
+        /* keep this chunk's scanner going until it's in step with another */
+        for (;;)
+        {
+            if (kind == ENDOFFILE)
+            {
+                addToken(&tokens, kind, offset, length, line + chunk->lineBase);
+
+                /* leave getToken()'s scanner where this one finished */
+                scan = chunk->state;
+                scan.line += chunk->lineBase;
+                return;
+            }
+
+            for (next = (int)(chunk - chunks) + 1; next < numChunks; ++next)
+            {
+                if (chunks[next].stop > sourceImage.text + offset)
+                    break;
+            }
+
+            if (next < numChunks)
+            {
+                found = findToken(&chunks[next].tokens, kind, offset);
+
+                if (found >= 0)
+                    break;
+            }
+
+            addToken(&tokens, kind, offset, length, line + chunk->lineBase);
+
+            kind = scanToken(&chunk->state);
+            offset = (int)(chunk->state.tokenStart - sourceImage.text);
+            length = chunk->state.tokenLength;
+            line = chunk->state.line;
         }
 
-    }  /* while (state != DONE) */
+        chunk = &chunks[next];
+        first = found;
+    }
+}
+
+
+/*
+ * NAME:     lexChunks()
+ * PURPOSE:  Scans the source file into the token buffer by cutting it
+ *            into "numChunks" chunks and scanning them in parallel.
+ */
+
+static void lexChunks(int numChunks)
+{
+    ScanChunk  *chunks;
+    const char *cut;
+    const char *end = sourceImage.text + sourceImage.length;
+    int        total;
+    int        i;
+
+    chunks = (ScanChunk*)calloc(numChunks, sizeof(*chunks));
+    if (chunks == NULL)
+    {
+        fprintf(listing, "*** Out of memory while scanning the source.\n");
+        exit(1);
+    }
+
+    /* cut the source up evenly, moving each cut onto the start of a line */
+    chunks[0].start = sourceImage.text;
+
+    for (i=1; i<numChunks; ++i)
+    {
+        cut = sourceImage.text + (sourceImage.length / numChunks) * i;
+
+        if (cut < chunks[i-1].start)
+            cut = chunks[i-1].start;
+        else if ((cut = (const char*)memchr(cut, '\n', end - cut)) == NULL)
+            cut = end;
+        else
+            ++cut;
+
+        chunks[i-1].stop = chunks[i].start = cut;
+    }
+
+    chunks[numChunks-1].stop = end;
+
+    for (i=0; i<numChunks; ++i)
+        chunks[i].listing = listing;
+
+    runThreads(lexChunk, chunks, numChunks, sizeof(*chunks));
+
+    for (i=1; i<numChunks; ++i)
+        chunks[i].lineBase = chunks[i-1].lineBase + chunks[i-1].newlines;
+
+    /* the whole file's tokens are about to go in, so make room for them */
+    for (i=0, total=0; i<numChunks; ++i)
+        total += chunks[i].tokens.count;
+    reserveTokens(&tokens, tokens.count + total);
+
+    stitchChunks(chunks, numChunks);
+
+    for (i=0; i<numChunks; ++i)
+        freeTokens(&chunks[i].tokens);
+    free(chunks);
+}
+
+
+#ifdef CHECK_PARALLEL_SCAN
+
+/*
+ * NAME:     checkParallelScan()
+ * PURPOSE:  Scans the source file again serially, and complains if the
+ *            tokens don't match those the parallel scan produced.
+ */
+
+static void checkParallelScan(void)
+{
+    ScanState   check;
+    TokenBuffer serial;
+    TokenType   token;
+    int         i;
+
+    memset(&serial, 0, sizeof(serial));
+    startScanner(&check, sourceImage.text);
+
+    do
+    {
+        token = scanToken(&check);
+        addToken(&serial, token, (int)(check.tokenStart - sourceImage.text),
+                 check.tokenLength, check.line);
+    }
+    while (token != ENDOFFILE);
+
+    for (i=0; (i < serial.count) && (i < tokens.count); ++i)
+    {
+        if ((serial.kind[i] != tokens.kind[i])
+                || (serial.offset[i] != tokens.offset[i])
+                || (serial.length[i] != tokens.length[i])
+                || (serial.line[i] != tokens.line[i]))
+            break;
+    }
+
+    if ((i < serial.count) || (i < tokens.count))
+        fprintf(listing, "*** Parallel scan differs from serial scan at "
+                         "token %d of %d.\n", i, serial.count);
+
+    freeTokens(&serial);
+}
+
+#endif /* CHECK_PARALLEL_SCAN */
+
+
+/*
+ * NAME:     lexSource()
+ * PURPOSE:  Scans the whole source file into the token buffer, ahead of
+ *            parsing.  Returns the number of tokens scanned.
+ *
+ *  With ScanThreads above one, a large enough source file is scanned in
+ *   parallel (except when it's being echoed, since the echo has to come
+ *   out in order).
+ */
+
+int lexSource(void)
+{
+    int numChunks = 0;
+
+    if (!EchoSource)
+        numChunks = (int)(sourceImage.length / MINCHUNKSIZE);
+
+    if (numChunks > ScanThreads)
+        numChunks = ScanThreads;
+
+    if (numChunks > 1)
+    {
+        lexChunks(numChunks);
+
+#ifdef CHECK_PARALLEL_SCAN
+        checkParallelScan();
+#endif
+    }
+    else
+    {
+        do
+        {
+            scanIntoBuffer();
+        }
+        while (tokens.kind[tokens.count-1] != ENDOFFILE);
+    }
+
+    return tokens.count;
+}
+
+
+/*
+ * NAME:     peekToken()
+ * PURPOSE:  Returns the token "ahead" places after the one that getToken()
+ *            last returned, without consuming anything.
+ */
+
+TokenType peekToken(int ahead)
+{
+    while (nextToken + ahead >= tokens.count)
+    {
+        /* there's nothing to see past the end of the file */
+        if ((tokens.count > 0)
+                && (tokens.kind[tokens.count-1] == ENDOFFILE))
+            return ENDOFFILE;
+
+        scanIntoBuffer();
+    }
+
+    return (TokenType)tokens.kind[nextToken + ahead];
+}
+
+
+/*
+ * NAME:     getToken()
+ * PURPOSE:  Returns the next token in the source file.
+ */
+
+TokenType getToken(void)
+{
+    TokenType  currentToken;
+    const char *lexeme;
+    int        length;
+
+    if (nextToken >= tokens.count)
+    {
+        /*
+         * We've handed out everything scanned so far.  Unless the buffer
+         *  is holding the whole file, start it again from the beginning.
+         */
+        if (!PreLexTokens)
+            tokens.count = nextToken = 0;
+
+        scanIntoBuffer();
+    }
+
+    currentToken = (TokenType)tokens.kind[nextToken];
+    lexeme = sourceImage.text + tokens.offset[nextToken];
+    length = tokens.length[nextToken];
+    lineno = tokens.line[nextToken];
+    ++nextToken;
+
+    /* hand the parser a handle for identifiers, rather than a lexeme */
+    if (currentToken == ID)
+        tokenSymbol = internString(lexeme, length);
+
+    /* tokenString gets a (possibly truncated) copy of the lexeme */
+    if (length > MAXTOKENLEN)
+        length = MAXTOKENLEN;
+    memcpy(tokenString, lexeme, length);
+    tokenString[length] = '\0';
 
     /*
      * If we've enabled the TraceScan option, output a detailed trace
@@ -11,6 +11,35 @@
 /* tokenString holds the lexeme being scanned */
 extern char tokenString[MAXTOKENLEN+1];
 
+/* tokenSymbol holds the interned name of the last ID token (see Intern.h) */
+extern char *tokenSymbol;
+
+/*
+ * NAME:     initScanner()
+ * PURPOSE:  Loads the source file into memory ready for scanning.  Returns
+ *            FALSE if the source file could not be read.
+ */
+
+int initScanner(void);
+
+
+/*
+ * NAME:     releaseScanner()
+ * PURPOSE:  Releases the in-memory copy of the source file.
+ */
+
+void releaseScanner(void);
+
+
+/*
+ * NAME:     lexSource()
+ * PURPOSE:  Scans the whole source file into the token buffer, ahead of
+ *            parsing.  Returns the number of tokens scanned.
+ */
+
+int lexSource(void);
+
+
 /*
  * NAME:     getToken()
  * PURPOSE:  Returns the next token in the source file.
@@ -18,6 +47,15 @@ extern char tokenString[MAXTOKENLEN+1];
 
 TokenType getToken(void);
 
+
+/*
+ * NAME:     peekToken()
+ * PURPOSE:  Returns the token "ahead" places after the one that getToken()
+ *            last returned, without consuming anything.
+ */
+
+TokenType peekToken(int ahead);
+
 #endif
 
 /* END OF FILE */
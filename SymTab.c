@@ -6,70 +6,118 @@
 #include <stdlib.h>
 
 #include "Globals.h"
+#include "Intern.h"
 #include "SymTab.h"
 #include "Util.h"
 
-/*
- *  The maximum number of buckets in the hash table.  This _may_ need to be
- *   modified if the hash function gets changed.
- */
-
-#define  MAXTABLESIZE 211
+#ifdef SYMTAB_BENCHMARK
+#include <time.h>
+#endif
 
 /*
- *  Symbol used to mark the high-water mark in the symbol table... note that
- *   this would be an invalid identifier.
+ *  The number of slots the hash table starts with.  It doubles whenever
+ *   more than half of them are in use, so it's always a power of two.
  */
 
-#define  HIGHWATERMARK "13_4_666_invalid"
+#define  INITIALSLOTS 256
 
 /****************************************************************************
  **  Structure, type and variable definitions
  */
 
 /*
- * NOTES: The symbol table is implemented as an open hash table.  Scope
- *  removal is done by using a single second list of nodes which has
- *  special "high water marks" inserted to facilitate easy scope removal.
+ * NOTES: Every symbol in scope has one HashNode in "symbols", a stack kept
+ *  in declaration order, so the symbols of the current scope are the ones
+ *  above its entry in "scopeStarts".  The hash table itself is open-
+ *  addressed (with linear probing), and each slot holds the index of the
+ *  newest symbol with a given name; a symbol that hides an older one from
+ *  an enclosing scope remembers it in "shadowed".  Each symbol is tagged
+ *  with the "level" of the scope it's declared in (0 for globals), so a
+ *  name is already declared in the current scope exactly when its newest
+ *  symbol is at the current level.
  *
- * The "high water mark" itself will be defined as a node with an illegal
- *  identifier name.
+ * Entering a scope just pushes the height of the symbol stack, and
+ *  leaving it pops the stack back down, putting back any shadowed symbols
+ *  on the way.
+ *
+ * All of that lives in a SymbolTable.  The thread that calls
+ *  initSymbolTable() uses "mainTable"; any other thread analysing part of
+ *  the program gets a table of its own from shareGlobals(), holding copies
+ *  of the globals it's allowed to see.
  */
 
+typedef struct symbolTable
+{
+    /* The hash table: 0 for an empty slot, or 1 + the index of a symbol */
+    int      *hashtable;
+
+    /* The number of slots in it (less one, to mask a hash value with) */
+    int      slotMask;
+
+    /* How many of its slots are in use */
+    int      slotsUsed;
+
+    /* The symbols in scope, oldest first */
+    HashNode *symbols;
+    int      numSymbols;
+    int      symbolCapacity;
+
+    /* Where each open scope starts in "symbols" */
+    int      *scopeStarts;
+    int      numScopes;
+    int      scopeCapacity;
+
+    /* Statistics reported by printSymbolTableStatistics() */
+    unsigned long numLookups;     /* calls to findSlot()          */
+    unsigned long numProbes;      /* slots they looked at         */
+    int           longestProbe;   /* most slots one of them did   */
+    int           numResizes;     /* times the table has doubled  */
 
-/* The hash table itself */
-static HashNodePtr hashtable[MAXTABLESIZE];
+    /* For a thread's own table, the one it stands in for until released */
+    struct symbolTable *outer;
+} SymbolTable;
 
-/* The "second list" (for lack of a better name), used to track scopes. */
-static HashNodePtr secondList;
+/* The table set up by initSymbolTable(), which has all the globals */
+static SymbolTable mainTable;
+
+/* The calling thread's table */
+static THREADLOCAL SymbolTable *table = NULL;
 
 /* Are we logging everything? */
 extern int TraceAnalyse;
 
 /* How many levels deep the current scope is... (used for reporting) */
-int scopeDepth;
+THREADLOCAL int scopeDepth;
 
 
 /****************************************************************************
  **  Prototypes for static function declarations
  */
 
-/* allocateSymbolNode(): allocate a new node.  If a parm is NIL it's ignored */
-static HashNodePtr allocateSymbolNode(char *name,
-                                      TreeNode *declaration,
-                                      int lineDefined);
+/* findSlot(): finds the slot for a name, or the empty slot it would go in */
+static int findSlot(SymbolTable *t, char *name);
+
+/* pushSymbol(): puts a symbol in scope, returning its slot */
+static int pushSymbol(SymbolTable *t, char *name, TreeNode *symbolDefNode,
+                      int lineDefined);
+
+/* allocateTable(): gives a table an empty hash table of the given size */
+static void allocateTable(SymbolTable *t, int numSlots);
 
-/* hashfunction(): takes a string and generates a hash value. */
-static int hashFunction(char *key);
+/* growTable(): doubles the size of a table's hash table */
+static void growTable(SymbolTable *t);
+
+/* emptySlot(): removes a name from the hash table */
+static void emptySlot(SymbolTable *t, int slot);
 
 /* error reporting */
 static void flagError(char *message);
 
 /* used in symbol table scope dump */
-static char *formatSymbolType(TreeNode *node);
+static void formatSymbolType(TreeNode *node, char *stringBuffer);
 
-/* the guts of dumpCurrentScope() */
-static void dumpCurrentScope2(HashNodePtr cursor);
+/* the guts of dumpCurrentScope(): prints a single symbol */
+static void dumpSymbol(HashNodePtr cursor);
 
 
 /****************************************************************************
@@ -79,51 +127,115 @@ static void dumpCurrentScope2(HashNodePtr cursor);
 
 void initSymbolTable(void)
 {
-    memset(hashtable, 0, sizeof(HashNodePtr) * MAXTABLESIZE);
-    secondList = NULL;
+    /* start again from scratch */
+    table = &mainTable;
+    releaseSymbolTable();
+
+    table = &mainTable;
+    allocateTable(table, INITIALSLOTS);
+}
+
+
+/* A thread's own table goes altogether; the main one is left empty */
+void releaseSymbolTable(void)
+{
+    SymbolTable *outer = NULL;
+
+    if (table == NULL)
+        return;
+
+    free(table->hashtable);
+    free(table->symbols);
+    free(table->scopeStarts);
+
+    if (table != &mainTable)
+    {
+        outer = table->outer;
+        free(table);
+    }
+    else
+        memset(&mainTable, 0, sizeof(mainTable));
+
+    table = outer;
+}
+
+
+/*
+ * The thread's table starts out like a fresh one from initSymbolTable(),
+ *  and the main table's globals are pushed onto it in the order they were
+ *  declared.  So it ends up just as the main table was after the last of
+ *  them was inserted, right down to the slots the names are in.
+ *
+ * The thread that owns the main table can have one of its own as well
+ *  (when runThreads() can't start a thread), standing in for the main
+ *  table until it's released.
+ */
+
+void shareGlobals(int numGlobals)
+{
+    HashNodePtr global;
+    SymbolTable *own;
+
+    if ((table == NULL) || (table == &mainTable))
+    {
+        own = (SymbolTable*)calloc(1, sizeof(SymbolTable));
+        if (own == NULL)
+        {
+            fprintf(listing,
+                    "*** Out of memory allocating memory for symbol table\n");
+            exit(1);
+        }
+
+        own->outer = table;
+        allocateTable(own, INITIALSLOTS);
+        table = own;
+    }
+
+    assert(table->numScopes == 0);
+    assert(numGlobals <= mainTable.numSymbols);
+
+    while (table->numSymbols < numGlobals)
+    {
+        global = &mainTable.symbols[table->numSymbols];
+        pushSymbol(table, global->name, global->declaration,
+                   global->lineFirstReferenced);
+    }
+}
+
+
+int countSymbols(void)
+{
+    return table->numSymbols;
 }
 
 
 void insertSymbol(char *name, TreeNode *symbolDefNode, int lineDefined)
 {
     char errorString[80];  /* for error reporting */
-
-    HashNodePtr newHashNode, temp;
-    int hashBucket;
+    int slot;
 
     /* If the symbol already exists, flag an error */
     if (symbolAlreadyDeclared(name))
     {
         sprintf(errorString, "duplicate identifier \"%s\"\n", name);
         flagError(errorString);
+        return;
     }
-    else
-    {
-        /* The symbol dosen't already exist, insert symbol. */
 
-        /* Locate bucket we're using */
-        hashBucket = hashFunction(name);
-        DEBUG_ONLY( fprintf(listing,
-                            "*** insertSymbol(%s): bucket is %d\n", name,hashBucket); );
+    /* The symbol dosen't already exist, insert symbol. */
+    slot = pushSymbol(table, name, symbolDefNode, lineDefined);
 
-        /* Allocate and insert record on front of bucket */
-        newHashNode = allocateSymbolNode(name, symbolDefNode, lineDefined);
-        if (newHashNode != NULL)
-        {
-            temp = hashtable[hashBucket];
-            hashtable[hashBucket] = newHashNode;
-            newHashNode->next = temp;
-        }
+    DEBUG_ONLY( fprintf(listing,
+                        "*** insertSymbol(%s): slot is %d\n", name, slot); );
+}
 
-        /* Stick node on front of "secondList" */
-        newHashNode = allocateSymbolNode(name, symbolDefNode, lineDefined);
-        if (newHashNode != NULL)
-        {
-            temp = secondList;
-            secondList = newHashNode;
-            secondList->next = temp;
-        }
-    }
+
+void declareGlobal(char *name, TreeNode *symbolDefNode, int lineDefined)
+{
+    assert(table->numScopes == 0);
+
+    if (!symbolAlreadyDeclared(name))
+        pushSymbol(table, name, symbolDefNode, lineDefined);
 }
 
 
@@ -134,78 +246,86 @@ void insertSymbol(char *name, TreeNode *symbolDefNode, int lineDefined)
 
 int symbolAlreadyDeclared(char *name)
 {
-    int         symbolFound = FALSE;  /* boolean */
-    HashNodePtr cursor;
+    SymbolTable *t = table;
+    int slot;
 
-    /* Scan "secondList" within _current_ scope for duplicate definition */
-    cursor = secondList;
+    /* Only the newest symbol with this name can be in the current scope */
+    slot = findSlot(t, name);
 
-    while ((cursor != NULL) && (!symbolFound)
-            && ((strcmp(cursor->name, HIGHWATERMARK) != 0)))
-    {
-        if (strcmp(name, cursor->name) == 0)
-            symbolFound = TRUE;
-        else
-            cursor = cursor->next;
-    }
-
-    return (symbolFound);
+    return (t->hashtable[slot] != 0)
+           && (t->symbols[t->hashtable[slot] - 1].level == t->numScopes);
 }
 
 
 HashNodePtr lookupSymbol(char *name)
 {
-    HashNodePtr cursor;
-    int         hashBucket;   /* hash bucket on which to conduct our search */
-    int         found = FALSE;  /* boolean */
+    SymbolTable *t = table;
+    int slot;
+
+    slot = findSlot(t, name);
 
-    hashBucket = hashFunction(name);
-    cursor = hashtable[hashBucket];
+    if (t->hashtable[slot] != 0)
+        return &t->symbols[t->hashtable[slot] - 1];
+    else
+        return NULL;
+}
 
-    while (cursor != NULL)
+
+/* A cluster is a run of used slots, which a probe may have to walk along */
+void printSymbolTableStatistics(void)
+{
+    SymbolTable *t = table;
+    int longestCluster = 0;
+    int cluster = 0;
+    int first = 0;
+    int i;
+
+    /* a cluster can wrap around the end of the table */
+    while ((first <= t->slotMask) && (t->hashtable[first] != 0))
+        ++first;
+
+    for (i = 1; i <= t->slotMask + 1; ++i)
     {
-        if (strcmp(name, cursor->name) == 0)
+        if (t->hashtable[(first + i) & t->slotMask] != 0)
         {
-            found = TRUE;
-            break;
+            if (++cluster > longestCluster)
+                longestCluster = cluster;
         }
-
-        cursor = cursor->next;
+        else
+            cluster = 0;
     }
 
-    if (found == TRUE)
-        return cursor;
-    else
-        return NULL;
+    fprintf(listing, "*** Symbol table: %lu lookups, %.2f probes each, "
+            "longest %d\n", t->numLookups,
+            (t->numLookups == 0) ? 0.0 : (double)t->numProbes / t->numLookups,
+            t->longestProbe);
+    fprintf(listing, "*** Symbol table: %d of %d slots used, "
+            "longest cluster %d, %d resizes\n",
+            t->slotsUsed, t->slotMask + 1, longestCluster, t->numResizes);
 }
 
 
 /*
- * Use recursion to dump symbols out in "reverse-reverse" order.. i.e the
- *  right way around...
+ * The current scope's symbols are on top of "symbols", and are dumped
+ *  out in the order they were declared.
  */
 
 void dumpCurrentScope()
 {
-    HashNodePtr cursor;
+    SymbolTable *t = table;
+    int i;
 
-    cursor = secondList;
-
-    /* if the current scope isn't empty,  dump it out */
-    if ((cursor != NULL) && (strcmp(HIGHWATERMARK, cursor->name)))
-        dumpCurrentScope2(cursor);
+    for (i = (t->numScopes > 0) ? t->scopeStarts[t->numScopes - 1] : 0;
+            i < t->numSymbols; ++i)
+        dumpSymbol(&t->symbols[i]);
 }
 
 #define IDENT_LEN 12
 
-static void dumpCurrentScope2(HashNodePtr cursor)
+static void dumpSymbol(HashNodePtr cursor)
 {
     char paddedIdentifier[IDENT_LEN+1];
-    char *typeInformation;   /* used to catch result of formatSymbolType */
-
-    if ((cursor->next != NULL)
-            && (strcmp(cursor->next->name, HIGHWATERMARK) != 0))
-        dumpCurrentScope2(cursor->next);
+    char typeInformation[100];   /* filled in by formatSymbolType */
 
     /* pad identifier name */
     memset(paddedIdentifier, ' ', IDENT_LEN);
@@ -213,36 +333,25 @@ static void dumpCurrentScope2(HashNodePtr cursor)
     paddedIdentifier[IDENT_LEN] = '\0';
 
     /* output symbol table entry */
-    typeInformation = formatSymbolType(cursor->declaration);
+    formatSymbolType(cursor->declaration, typeInformation);
 
     fprintf(listing, "%3d   %s   %7d     %c    %s\n",
             scopeDepth,
             paddedIdentifier,
             cursor->lineFirstReferenced,
-            cursor->declaration->isParameter ? 'Y' : 'N',
+            DECINFO(cursor->declaration)->isParameter ? 'Y' : 'N',
             typeInformation);
-
-    /* Prevent a memory leak - (bjf, 11/5/2000) */
-    free(typeInformation);
 }
 
 
 void newScope()
 {
-    HashNodePtr newNode, temp;
+    SymbolTable *t = table;
 
-    /*
-     * This function is short and sweet: we just append a "high water mark"
-     *  on "secondList".
-     */
-
-    newNode = allocateSymbolNode(HIGHWATERMARK, NULL, 0);
-    if (newNode != NULL)
-    {
-        temp = secondList;
-        secondList = newNode;
-        secondList->next = temp;
-    }
+    /* This function is short and sweet: remember where the scope starts */
+    t->scopeStarts = (int*)growStack(t->scopeStarts, t->numScopes,
+                                     &t->scopeCapacity, sizeof(int));
+    t->scopeStarts[t->numScopes++] = t->numSymbols;
 }
 
 
@@ -250,48 +359,37 @@ void endScope()
 {
     /*
      * endScope()'s job is to delete all symbols in the current scope.  It
-     *  works by scanning "secondList" from the front and for each record
-     *  before the high-water mark, it deletes each symbol's occurrence in
-     *  the hash table.  This is done until the high-water mark is consumed.
+     *  pops them off "symbols", and for each one puts back the symbol it
+     *  was hiding in the hash table, or empties its slot if there wasn't
+     *  one.
      */
 
-    HashNodePtr hashPtr;
-    HashNodePtr temp;  /* used in freeing HashNodes */
-    int         hashBucket;
+    SymbolTable *t = table;
+    HashNodePtr symbol;
+    int         slot;
+
+    assert(t->numScopes > 0);
+    --t->numScopes;
 
-    while ((secondList != NULL)
-            && (strcmp(HIGHWATERMARK, secondList->name)) != 0)
+    while (t->numSymbols > t->scopeStarts[t->numScopes])
     {
-        /* locate this node in the hash table, delete it */
-        hashBucket = hashFunction(secondList->name);
-        hashPtr = hashtable[hashBucket];
+        symbol = &t->symbols[--t->numSymbols];
+        slot = findSlot(t, symbol->name);
 
         /*
-         *  INVARIANT: since symbols were inserted into the hash table _and_
-         *    secondList in the same order, the name of the symbol on the
-         *    front of the hash bucket _must_ be the same as the one under
-         *    secondListPtr.
+         *  INVARIANT: since scopes nest, the symbol on top of the stack
+         *    must be the newest one with its name.
          */
+        assert(t->hashtable[slot] == t->numSymbols + 1);
 
-        assert((secondList != NULL) && (hashtable[hashBucket] != NULL));
-        assert(strcmp(secondList->name, hashPtr->name) == 0);
-
-        /* delete from hash table */
-        temp = hashtable[hashBucket]->next;
-        free(hashtable[hashBucket]);
-        hashtable[hashBucket] = temp;
-
-        /* ... and from second list */
-        temp = secondList->next;
-        free(secondList);
-        secondList = temp;
+        if (symbol->shadowed >= 0)
+            t->hashtable[slot] = symbol->shadowed + 1;
+        else
+        {
+            emptySlot(t, slot);
+            --t->slotsUsed;
+        }
     }
-
-    /* delete high water mark */
-    assert(strcmp(secondList->name, HIGHWATERMARK) == 0);
-    temp = secondList->next;
-    free(secondList);
-    secondList = temp;
 }
 
 
@@ -299,48 +397,217 @@ void endScope()
  **  Static function definitions
  */
 
-static HashNodePtr allocateSymbolNode(char *name,
-                                      TreeNode *declaration,
-                                      int lineDefined)
+/* The hash value was computed once, when the name was interned */
+static int findSlot(SymbolTable *t, char *name)
 {
-    HashNode *temp;
+    int slot = (int)(internHash(name) & t->slotMask);
+    int probes = 1;
 
-    temp = (HashNode*)malloc(sizeof(HashNode));
-    if (temp == NULL)
+    while ((t->hashtable[slot] != 0)
+            && (t->symbols[t->hashtable[slot] - 1].name != name))
+    {
+        slot = (slot + 1) & t->slotMask;
+        ++probes;
+    }
+
+    ++t->numLookups;
+    t->numProbes += probes;
+    if (probes > t->longestProbe)
+        t->longestProbe = probes;
+
+    return slot;
+}
+
+
+static int pushSymbol(SymbolTable *t, char *name, TreeNode *symbolDefNode,
+                      int lineDefined)
+{
+    HashNodePtr newHashNode;
+    int slot;
+
+    /* Locate slot we're using, making room for it if it's a new one */
+    slot = findSlot(t, name);
+    if ((t->hashtable[slot] == 0) && (2 * (t->slotsUsed + 1) > t->slotMask + 1))
+    {
+        growTable(t);
+        slot = findSlot(t, name);
+    }
+
+    /* Push the symbol, hiding any older one of the same name */
+    t->symbols = (HashNode*)growStack(t->symbols, t->numSymbols,
+                                      &t->symbolCapacity, sizeof(HashNode));
+
+    newHashNode = &t->symbols[t->numSymbols];
+    newHashNode->name = name;   /* interned, so no need for a copy */
+    newHashNode->declaration = symbolDefNode;
+    newHashNode->lineFirstReferenced = lineDefined;
+    newHashNode->level = t->numScopes;
+    newHashNode->shadowed = t->hashtable[slot] - 1;
+
+    if (t->hashtable[slot] == 0)
+        ++t->slotsUsed;
+    t->hashtable[slot] = ++t->numSymbols;
+
+    return slot;
+}
+
+
+static void allocateTable(SymbolTable *t, int numSlots)
+{
+    t->hashtable = (int*)calloc(numSlots, sizeof(int));
+    if (t->hashtable == NULL)
     {
-        Error = TRUE;
         fprintf(listing,
                 "*** Out of memory allocating memory for symbol table\n");
+        exit(1);
     }
-    else
+
+    t->slotMask = numSlots - 1;
+}
+
+
+/*
+ * Each name is in the table just once, so moving to the bigger table is
+ *  just a matter of dropping every used slot into the first free one
+ *  from where its name now hashes to.
+ */
+
+static void growTable(SymbolTable *t)
+{
+    int *oldTable = t->hashtable;
+    int oldSize = t->slotMask + 1;
+    int slot;
+    int i;
+
+    allocateTable(t, 2 * oldSize);
+
+    for (i = 0; i < oldSize; ++i)
     {
-        temp->name = copyString(name);
-        temp->declaration = declaration;
-        temp->lineFirstReferenced = lineDefined;
-        temp->next = NULL;
+        if (oldTable[i] != 0)
+        {
+            slot = (int)(internHash(t->symbols[oldTable[i] - 1].name)
+                         & t->slotMask);
+            while (t->hashtable[slot] != 0)
+                slot = (slot + 1) & t->slotMask;
+
+            t->hashtable[slot] = oldTable[i];
+        }
     }
 
-    return temp;
+    free(oldTable);
+    ++t->numResizes;
 }
 
-/* Power-of-two multiplier in hash function */
-#define SHIFT 4
 
-/* Code borrowed from Louden p.522 */
-static int hashFunction( char *key)
+/*
+ * Emptying a slot could cut off names that probed past it, so move any
+ *  of those back into the hole (backward-shift deletion).
+ */
+
+static void emptySlot(SymbolTable *t, int slot)
 {
-    int temp = 0;
-    int i = 0;
+    int next = slot;
+    int home;    /* the slot a name hashes to */
 
-    while (key[i] != '\0')
+    t->hashtable[slot] = 0;
+
+    for (;;)
     {
-        temp = ((temp << SHIFT) + key[i]) % MAXTABLESIZE;
-        ++i;
+        next = (next + 1) & t->slotMask;
+        if (t->hashtable[next] == 0)
+            return;
+
+        home = (int)(internHash(t->symbols[t->hashtable[next] - 1].name)
+                     & t->slotMask);
+
+        /* can the name in "next" move back to "slot"? */
+        if (((next - home) & t->slotMask)
+                >= ((next - slot) & t->slotMask))
+        {
+            t->hashtable[slot] = t->hashtable[next];
+            t->hashtable[next] = 0;
+            slot = next;
+        }
     }
+}
+
+
+#ifdef SYMTAB_BENCHMARK
 
-    return temp;
+/*
+ * The scope doubles in size from 1000 symbols up to BENCHMARKMAXSYMBOLS;
+ *  since both inserting and the duplicate check are a single probe, the
+ *  cost per symbol should stay flat as it does.  The insertion times
+ *  include writing the debug trace (to a scratch file).
+ */
+
+#define BENCHMARKMAXSYMBOLS  256000
+#define BENCHMARKREPEATS     20
+
+void benchmarkSymbolTable(void)
+{
+    static char *names[BENCHMARKMAXSYMBOLS];
+    char    nameBuffer[20];
+    FILE    *realListing = listing;
+    FILE    *scratch;
+    clock_t start;
+    double  insertTime, checkTime;
+    int     size, repeat, i;
+    int     duplicates;
+
+    for (i = 0; i < BENCHMARKMAXSYMBOLS; ++i)
+    {
+        sprintf(nameBuffer, "sym%d", i);
+        names[i] = internName(nameBuffer);
+    }
+
+    scratch = tmpfile();
+    if (scratch == NULL)
+        return;
+
+    fprintf(realListing,
+            "*** Symbols in scope   ns per insert   ns per check\n");
+
+    for (size = 1000; size <= BENCHMARKMAXSYMBOLS; size *= 2)
+    {
+        insertTime = checkTime = 0;
+        duplicates = 0;
+
+        for (repeat = 0; repeat < BENCHMARKREPEATS; ++repeat)
+        {
+            initSymbolTable();
+            newScope();
+
+            listing = scratch;
+            start = clock();
+            for (i = 0; i < size; ++i)
+                insertSymbol(names[i], NULL, 0);
+            insertTime += (double)(clock() - start);
+            listing = realListing;
+
+            start = clock();
+            for (i = 0; i < size; ++i)
+                duplicates += symbolAlreadyDeclared(names[i]);
+            checkTime += (double)(clock() - start);
+
+            endScope();
+        }
+
+        fprintf(listing, "    %16d   %13.1f   %12.1f\n", size,
+                insertTime * 1e9 / CLOCKS_PER_SEC / size / BENCHMARKREPEATS,
+                checkTime * 1e9 / CLOCKS_PER_SEC / size / BENCHMARKREPEATS);
+
+        if (duplicates != size * BENCHMARKREPEATS)
+            fprintf(listing, "*** Only %d of %d duplicates found!\n",
+                    duplicates, size * BENCHMARKREPEATS);
+    }
+
+    releaseSymbolTable();
+    fclose(scratch);
 }
 
+#endif /* SYMTAB_BENCHMARK */
+
 
 static void flagError(char *message)
 {
@@ -349,10 +616,8 @@ static void flagError(char *message)
 }
 
 
-static char *formatSymbolType(TreeNode *node)
+static void formatSymbolType(TreeNode *node, char *stringBuffer)
 {
-    char stringBuffer[100];
-
     if ((node == NULL) || (node->nodekind != DecK))
         strcpy(stringBuffer, "<<ERROR>>");
     else
@@ -362,23 +627,21 @@ static char *formatSymbolType(TreeNode *node)
         {
         case ScalarDecK:
             sprintf(stringBuffer, "Scalar of type %s",
-                    typeName(node->variableDataType));
+                    typeName(DECINFO(node)->variableDataType));
             break;
         case ArrayDecK:
             sprintf(stringBuffer, "Array of type %s with %d elements",
-                    typeName(node->variableDataType), node->val);
+                    typeName(DECINFO(node)->variableDataType), node->val);
             break;
         case FuncDecK:
             sprintf(stringBuffer, "Function with return type %s",
-                    typeName(node->functionReturnType));
+                    typeName(DECINFO(node)->functionReturnType));
             break;
         default:
             strcpy(stringBuffer, "<<UNKNOWN>>");
             break;
         }
     }
-
-    return copyString(stringBuffer);
 }
 
 
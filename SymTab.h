@@ -6,6 +6,13 @@
 
 #include "Globals.h"
 
+/*
+ * Uncomment this to build the compiler as a symbol table benchmark
+ *  instead: see benchmarkSymbolTable().
+ */
+
+/* #define SYMTAB_BENCHMARK */
+
 /*********************************************************************
  * Type definitions that need to be visible from the outside
  */
@@ -19,11 +26,11 @@
 
 typedef struct hashNode
 {
-    char          *name;        /* the name of the identifier */
+    char          *name;        /* interned name of the identifier */
     TreeNode      *declaration;  /* pointer to the symbol's dec. node */
     int           lineFirstReferenced;   /* self-explanatory */
-    struct hashNode *next;      /* next node on this bucket chain */
-    int           level;
+    int           shadowed;     /* index of the symbol this one hides, or -1 */
+    int           level;        /* nesting level of the declaring scope */
 	int           count;
     int			  offset;
 } HashNode, *HashNodePtr;
@@ -31,9 +38,9 @@ typedef struct hashNode
 
 /*
  *  Keep track of how deep the scopes are in the symbol table - used for
- *   reporting.
+ *   reporting.  Each thread has its own.
  */
-extern int scopeDepth;
+extern THREADLOCAL int scopeDepth;
 
 
 /*
@@ -45,15 +52,62 @@ extern int scopeDepth;
 void initSymbolTable();
 
 
+/*
+ * NAME:    releaseSymbolTable()
+ * PURPOSE: Frees everything the symbol table has allocated.
+ */
+
+void releaseSymbolTable(void);
+
+
+/*
+ * NAME:    shareGlobals()
+ * PURPOSE: Gives the calling thread a symbol table of its own, if it hasn't
+ *           one yet, and brings it up to the first "numGlobals" symbols
+ *           declared in the table initSymbolTable() set up.  The thread must
+ *           be at global scope, and nothing may change the main table
+ *           until releaseSymbolTable() puts the thread back on whichever
+ *           table it was using before.
+ *
+ *          Every routine here works on the calling thread's table.
+ */
+
+void shareGlobals(int numGlobals);
+
+
+/*
+ * NAME:    countSymbols()
+ * PURPOSE: Returns how many symbols are in scope.  At global scope, that
+ *           is the number to give shareGlobals() to let another thread
+ *           see the globals declared so far.
+ */
+
+int countSymbols(void);
+
+
 /*
  * NAME:    insertSymbol()
  * PURPOSE: Inserts line numbers and a TreeNode pointer to an identifier's
  *           declaration.
+ *
+ *          Names passed to the symbol table routines must be interned (see
+ *           Intern.h); they are compared by address.
  */
 
 void insertSymbol(char *name, TreeNode *symbolDefNode, int lineDefined);
 
 
+/*
+ * NAME:    declareGlobal()
+ * PURPOSE: Like insertSymbol(), for the global scope, but silent: it traces
+ *           nothing, and quietly ignores a duplicate.  It's for getting the
+ *           globals in ahead of analysing the program in parallel, which
+ *           reports on them as it goes.
+ */
+
+void declareGlobal(char *name, TreeNode *symbolDefNode, int lineDefined);
+
+
 /*
  * NAME:    symbolAlreadyDeclared()
  * PURPOSE: Checks to see if the given symbol is already defined in the
@@ -71,6 +125,8 @@ int symbolAlreadyDeclared(char *name);
  * PURPOSE: Retrieves a HashNode* pointer for a supplied identifier that
  *           points to the declaration node for the identifier. If the
  *           operaton failed, NULL is returned.
+ *
+ *          The pointer is only good until the next symbol is inserted.
  */
 
 HashNodePtr lookupSymbol(char *name);
@@ -84,12 +140,21 @@ HashNodePtr lookupSymbol(char *name);
 void dumpCurrentScope();
 
 
+/*
+ * NAME:    printSymbolTableStatistics()
+ * PURPOSE: Prints how many slots lookups have had to probe, and how full
+ *           and clustered the hash table is.  Only the calling thread's
+ *           table is counted.
+ */
+
+void printSymbolTableStatistics(void);
+
+
 /*
  * NAME:    newScope()
- * PURPOSE: Creates a new scope by creating a new "high water mark" on
- *           the symbol table.  This facilitates the destruction of all
- *           symbol table entries for a local scope on a subsequent
- *           call to endScope().
+ * PURPOSE: Creates a new scope by marking the top of the symbol stack.
+ *           This facilitates the destruction of all symbol table entries
+ *           for a local scope on a subsequent call to endScope().
  */
 
 void newScope();
@@ -98,13 +163,27 @@ void newScope();
 /*
  * NAME:    endScope()
  * PURPOSE: Deletes all the local variables in the local scope by deleting
- *           all symbol table entries up to a high-water mark created by
- *           an earlier call to newScope().
+ *           all symbol table entries above the mark made by an earlier
+ *           call to newScope().
  */
 
 void endScope();
 
 
+#ifdef SYMTAB_BENCHMARK
+
+/*
+ * NAME:    benchmarkSymbolTable()
+ * PURPOSE: Times declaring ever more symbols in a single scope, and then
+ *           checking each of them for a duplicate, and reports the cost
+ *           per symbol to the listing.
+ */
+
+void benchmarkSymbolTable(void);
+
+#endif
+
+
 #endif
 
 /* END OF FILE */
@@ -0,0 +1,123 @@
+#include "Globals.h"
+#include "Util.h"
+#include "TMObject.h"
+
+
+/* Function prototypes for module statics */
+
+static int objectError(TMObject *object, char *fileName, char *problem);
+
+
+/*
+ * NAME:     loadObject()
+ * PURPOSE:  Maps the object file "fileName" into memory (reading it
+ *            where it can't be mapped) and checks that it's sound.
+ *            Returns FALSE, having said why, if it isn't.
+ *
+ *  Nothing is copied or converted: once the header checks out, the
+ *   sections are simply found where they lie in the file image.
+ */
+
+int loadObject(char *fileName, TMObject *object)
+{
+    FILE           *file;
+    TMObjectHeader *header;
+    size_t         length;
+    size_t         expected;
+    int            loaded;
+
+    memset(object, 0, sizeof(*object));
+
+    file = fopen(fileName, "rb");
+    if (file == NULL)
+        return objectError(object, fileName, "could not be opened");
+
+    loaded = loadFileImage(file, &object->image);
+    fclose(file);
+    if (!loaded)
+        return objectError(object, fileName, "could not be read");
+
+    length = object->image.length;
+    if (length < sizeof(TMObjectHeader))
+        return objectError(object, fileName, "is too short");
+
+    header = (TMObjectHeader*)object->image.text;
+    if (header->magic != TMOBJECT_MAGIC)
+        return objectError(object, fileName, "is not a TM object file");
+    if (header->version != TMOBJECT_VERSION)
+        return objectError(object, fileName, "is of the wrong version");
+
+    if ((header->numInstructions < 0) || (header->dataSize < 0)
+            || (header->numSymbols < 0) || (header->numLines < 0)
+            || (header->stringSize < 0))
+        return objectError(object, fileName, "has a corrupt header");
+
+    expected = sizeof(TMObjectHeader)
+               + (size_t)header->numInstructions * sizeof(TMInstruction)
+               + (size_t)header->dataSize * sizeof(int)
+               + (size_t)header->numSymbols * sizeof(TMSymbol)
+               + (size_t)header->numLines * sizeof(TMLine)
+               + (size_t)header->stringSize;
+    if (length != expected)
+        return objectError(object, fileName, "is the wrong size");
+
+    /* the sections follow one another, each a multiple of 4 bytes */
+    object->header = header;
+    object->code = (TMInstruction*)(header + 1);
+    object->data = (int*)(object->code + header->numInstructions);
+    object->symbols = (TMSymbol*)(object->data + header->dataSize);
+    object->lines = (TMLine*)(object->symbols + header->numSymbols);
+    object->strings = (char*)(object->lines + header->numLines);
+
+    if (!(header->flags & TMOBJECT_SYMBOLS))
+        object->symbols = NULL;
+    if (!(header->flags & TMOBJECT_LINES))
+        object->lines = NULL;
+
+    return TRUE;
+}
+
+
+/*
+ * NAME:     releaseObject()
+ * PURPOSE:  Unmaps an object loaded by loadObject().
+ */
+
+void releaseObject(TMObject *object)
+{
+    releaseFileImage(&object->image);
+    memset(object, 0, sizeof(*object));
+}
+
+
+/*
+ * NAME:     printObjectSummary()
+ * PURPOSE:  Prints the sizes of a loaded object's sections to the
+ *            listing file.
+ */
+
+void printObjectSummary(TMObject *object)
+{
+    fprintf(listing, "*** Object file: %d instructions, %d data words, "
+            "%d symbols, %d line entries, %lu bytes\n",
+            object->header->numInstructions, object->header->dataSize,
+            object->header->numSymbols, object->header->numLines,
+            (unsigned long)object->image.length);
+}
+
+
+/*
+ * NAME:     objectError()
+ * PURPOSE:  Reports that an object file can't be loaded, releases what
+ *            there is of it, and returns FALSE.
+ */
+
+static int objectError(TMObject *object, char *fileName, char *problem)
+{
+    fprintf(listing, ">>> The object file \"%s\" %s.\n", fileName, problem);
+    releaseObject(object);
+    return FALSE;
+}
+
+
+/* END OF FILE */
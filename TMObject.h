@@ -0,0 +1,122 @@
+/*
+ * The binary TM object format.
+ *
+ * A runner that loads a textual ".tm" file has to parse every line of
+ *  it; a ".tmo" file is laid out so that it can be mapped straight into
+ *  memory and used where it lies.  It is, in order:
+ *
+ *   - a TMObjectHeader;
+ *   - "numInstructions" TMInstructions, one per TM location from 0;
+ *   - "dataSize" words: the initial image of the data segment, which
+ *      holds the global variables at the start of the TM's data memory;
+ *   - "numSymbols" TMSymbols and "numLines" TMLines, if the header's
+ *      flags say they are there;
+ *   - "stringSize" bytes of null-terminated symbol names.
+ *
+ * Every field is a 32-bit int, except a TMInstruction's op and register
+ *  fields, which are bytes, and the byte of padding after them.  The ints
+ *  are in the byte order of the machine that wrote the file; a reader on a
+ *  machine of the other byte order will find the magic number reversed.
+ */
+
+#ifndef _TMOBJECT_H_
+#define _TMOBJECT_H_
+
+#include "Util.h"
+
+
+#define TMOBJECT_MAGIC   0x4F4D5401   /* "\1TMO", written little-endian */
+#define TMOBJECT_VERSION 1
+
+/* Header flags */
+#define TMOBJECT_SYMBOLS 1   /* there is a symbol table */
+#define TMOBJECT_LINES   2   /* there is a line table */
+
+typedef struct
+{
+    unsigned int magic;        /* TMOBJECT_MAGIC                         */
+    unsigned int version;      /* TMOBJECT_VERSION                       */
+    unsigned int flags;        /* TMOBJECT_SYMBOLS and/or TMOBJECT_LINES */
+    int          numInstructions;
+    int          dataSize;     /* words of data segment image            */
+    int          numSymbols;
+    int          numLines;
+    int          stringSize;   /* bytes of symbol names, padded to 4     */
+} TMObjectHeader;
+
+/* One instruction, whether register-only ("op r,s,t": d is t)
+ * or register-memory ("op r,d(s)"); op is an OpCode (see Code.h).
+ * A location that was never emitted holds HALT 0,0,0.
+ */
+typedef struct
+{
+    unsigned char op;
+    signed char   r, s;
+    unsigned char unused;
+    int           d;
+} TMInstruction;
+
+/* Symbol kinds */
+#define TMCODESYMBOL 0   /* a function: "value" is its entry location */
+#define TMDATASYMBOL 1   /* a global: "value" is its data offset */
+
+typedef struct
+{
+    int kind;     /* TMCODESYMBOL or TMDATASYMBOL           */
+    int value;    /* its location or offset                 */
+    int size;     /* words of data, or 0 for code           */
+    int name;     /* offset of its name in the string table */
+} TMSymbol;
+
+/* The line table holds one entry for each run of instructions
+ * generated from the same source line, in location order
+ */
+typedef struct
+{
+    int loc;      /* the first location of the run */
+    int line;     /* its source line               */
+} TMLine;
+
+/* A loaded object: every pointer points into "image" */
+typedef struct
+{
+    FileImage      image;
+    TMObjectHeader *header;
+    TMInstruction  *code;
+    int            *data;
+    TMSymbol       *symbols;   /* NULL without TMOBJECT_SYMBOLS */
+    TMLine         *lines;     /* NULL without TMOBJECT_LINES   */
+    char           *strings;
+} TMObject;
+
+
+/*
+ * NAME:     loadObject()
+ * PURPOSE:  Maps the object file "fileName" into memory (reading it
+ *            where it can't be mapped) and checks that it's sound.
+ *            Returns FALSE, having said why, if it isn't.
+ */
+
+int loadObject(char *fileName, TMObject *object);
+
+
+/*
+ * NAME:     releaseObject()
+ * PURPOSE:  Unmaps an object loaded by loadObject().
+ */
+
+void releaseObject(TMObject *object);
+
+
+/*
+ * NAME:     printObjectSummary()
+ * PURPOSE:  Prints the sizes of a loaded object's sections to the
+ *            listing file.
+ */
+
+void printObjectSummary(TMObject *object);
+
+
+#endif
+
+/* END OF FILE */
@@ -0,0 +1,135 @@
+
+
+#include <stdlib.h>
+
+#include "Thread.h"
+
+/*
+ * Define NO_THREADS to build a compiler that never starts a thread, for
+ *  platforms without them (or to rule threads out when debugging).
+ */
+
+/* #define NO_THREADS */
+
+/*
+ * Globals.h isn't included here: <windows.h> defines macros (VOID, for
+ *  one) that clash with the compiler's token names.
+ */
+
+#ifndef NO_THREADS
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+
+#ifndef NO_THREADS
+
+/* What each thread is started with */
+typedef struct
+{
+    ThreadWork work;      /* the work to do   */
+    void       *item;     /* the item to do it on */
+} ThreadStart;
+
+
+/*
+ * NAME:     threadMain()
+ * PURPOSE:  The entry point of every thread runThreads() starts.
+ */
+
+#ifdef _WIN32
+static unsigned __stdcall threadMain(void *arg)
+#else
+static void *threadMain(void *arg)
+#endif
+{
+    ThreadStart *start = (ThreadStart*)arg;
+
+    start->work(start->item);
+
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+#endif /* NO_THREADS */
+
+
+void runThreads(ThreadWork work, void *items, int count, size_t itemSize)
+{
+#ifdef NO_THREADS
+
+    int i;
+
+    for (i=0; i<count; ++i)
+        work((char*)items + i * itemSize);
+
+#else
+
+    ThreadStart *starts;
+    int         *started;
+    int         i;
+#ifdef _WIN32
+    HANDLE      *threads;
+#else
+    pthread_t   *threads;
+#endif
+
+    starts = (ThreadStart*)malloc(count * sizeof(*starts));
+    started = (int*)malloc(count * sizeof(*started));
+    threads = malloc(count * sizeof(*threads));
+
+    if ((starts == NULL) || (started == NULL) || (threads == NULL))
+    {
+        /* no room to keep track of threads, so do it all here */
+        for (i=0; i<count; ++i)
+            work((char*)items + i * itemSize);
+    }
+    else
+    {
+        for (i=0; i<count; ++i)
+        {
+            starts[i].work = work;
+            starts[i].item = (char*)items + i * itemSize;
+
+#ifdef _WIN32
+            threads[i] = (HANDLE)_beginthreadex(NULL, 0, threadMain,
+                                                &starts[i], 0, NULL);
+            started[i] = (threads[i] != 0);
+#else
+            started[i] = (pthread_create(&threads[i], NULL, threadMain,
+                                         &starts[i]) == 0);
+#endif
+            if (!started[i])
+                work(starts[i].item);
+        }
+
+        for (i=0; i<count; ++i)
+        {
+            if (!started[i])
+                continue;
+
+#ifdef _WIN32
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+#else
+            pthread_join(threads[i], NULL);
+#endif
+        }
+    }
+
+    free(starts);
+    free(started);
+    free(threads);
+
+#endif /* NO_THREADS */
+}
+
+
+/* END OF FILE */
@@ -0,0 +1,44 @@
+
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stddef.h>
+
+/*
+ * A very small wrapper around the platform's threads: just enough to farm
+ *  an array of independent work items out to one thread each and wait for
+ *  them all.  Define NO_THREADS in Thread.c to run the items one after
+ *  another on the calling thread instead.
+ */
+
+/*
+ * THREADLOCAL marks a global or static variable that each thread has its
+ *  own copy of.
+ */
+
+#ifdef _MSC_VER
+#define THREADLOCAL __declspec(thread)
+#else
+#define THREADLOCAL __thread
+#endif
+
+
+/* the work to do on one item of the array */
+typedef void (*ThreadWork)(void *item);
+
+
+/*
+ * NAME:     runThreads()
+ * PURPOSE:  Calls "work" on each of the "count" items at "items" (each of
+ *            them "itemSize" bytes long), one thread per item, and returns
+ *            once every call has finished.
+ *
+ *  If a thread can't be started, its item is done on the calling thread.
+ */
+
+void runThreads(ThreadWork work, void *items, int count, size_t itemSize);
+
+#endif
+
+/* END OF FILE */
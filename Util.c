@@ -2,14 +2,35 @@
 
 
 #include "Globals.h"
+#include "Arena.h"
 #include "Util.h"
 
 #include <string.h>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 
 /* Function prototypes for module statics */
 
 static TreeNode *allocNewNode(void);
+static int allocPoolPages(void);
+static int mapFileImage(FILE *file, FileImage *image);
+static int readFileImage(FILE *file, FileImage *image);
+
+
+/* The node pool (see Util.h) */
+
+TreeNode *nodePages[MAXNODEPAGES];
+DecInfo  *decInfoPages[MAXNODEPAGES];
+
+static NodeIndex    numNodes = 0;      /* nodes allocated, counting 0 */
+static unsigned int numDecInfos = 0;   /* DecInfo entries allocated   */
 
 
 /*
@@ -103,17 +124,14 @@ void printToken(TokenType token, const char* lexeme)
     }
 }
 
-/* The following definitions relate to the printTree() function */
-static int indentno = 0;
-
-#define INDENT   indentno += 4
-#define UNINDENT indentno -= 4
+/* printTree() indents each level of the tree by this many spaces */
+#define INDENTSIZE 4
 
-static void printSpaces(void)
+static void printSpaces(int count)
 {
     int i;
 
-    for (i=0; i<indentno; ++i)
+    for (i=0; i<count; ++i)
         fprintf(listing, " ");
 }
 
@@ -146,13 +164,19 @@ char *typeName(ExpType type)
 
 void printTree(TreeNode *tree)
 {
-    int i;
+    TreeWalk walk;
+    int      step;
 
-    INDENT;
+    startWalk(&walk, tree);
 
-    while (tree != NULL)  /* try not to visit null tree children */
+    while ((step = walkTree(&walk)) != WALKDONE)
     {
-        printSpaces();
+        /* everything's printed on the way down */
+        if (step != WALKENTER)
+            continue;
+
+        tree = walk.node;
+        printSpaces(INDENTSIZE * walk.depth);
 
         /* Examine node type, and base output on that. */
         if (tree->nodekind == DecK)
@@ -161,17 +185,17 @@ void printTree(TreeNode *tree)
             {
             case ScalarDecK:
                 fprintf(listing,"[Scalar declaration \"%s\" of type \"%s\"]\n"
-                        , tree->name, typeName(tree->variableDataType));
+                        , tree->name, typeName(DECINFO(tree)->variableDataType));
                 break;
             case ArrayDecK:
                 fprintf(listing, "[Array declaration \"%s\" of size %d"
                         " and type \"%s\"]\n",
-                        tree->name, tree->val, typeName(tree->variableDataType));
+                        tree->name, tree->val, typeName(DECINFO(tree)->variableDataType));
                 break;
             case FuncDecK:
                 fprintf(listing, "[Function declaration \"%s()\""
                         " of return type \"%s\"]\n",
-                        tree->name, typeName(tree->functionReturnType));
+                        tree->name, typeName(DECINFO(tree)->functionReturnType));
                 break;
             default:
                 fprintf(listing, "<<<unknown declaration type>>>\n");
@@ -224,6 +248,10 @@ void printTree(TreeNode *tree)
                 fprintf(listing, "[Call to function \"%s()\"]\n",
                         tree->name);
                 break;
+            case InlineK:
+                fprintf(listing, "[Inlined call to function \"%s()\"]\n",
+                        tree->name);
+                break;
             default:
                 fprintf(listing, "<<<unknown statement type>>>\n");
                 break;
@@ -231,14 +259,9 @@ void printTree(TreeNode *tree)
         }
         else
             fprintf(listing, "<<<unknown node kind>>>\n");
-
-        for (i=0; i<MAXCHILDREN; ++i)
-            printTree(tree->child[i]);
-
-        tree = tree->sibling;
     }
 
-    UNINDENT;
+    endWalk(&walk);
 }
 
 
@@ -296,12 +319,155 @@ TreeNode *newDecNode(DecKind kind)
     {
         t->nodekind = DecK;
         t->kind.dec = kind;
+
+        /* the pages for both pools are allocated together */
+        t->decInfo = numDecInfos++;
     }
 
     return t;
 }
 
 
+NodeIndex nodeIndex(TreeNode *node)
+{
+    return (node == NULL) ? 0 : node->index;
+}
+
+
+void resetNodePool(void)
+{
+    memset(nodePages, 0, sizeof(nodePages));
+    memset(decInfoPages, 0, sizeof(decInfoPages));
+    numNodes = numDecInfos = 0;
+}
+
+
+/*
+ * A walk keeps a frame for each node it's inside, recording which of the
+ *  node's children to walk next.
+ */
+
+struct walkFrame
+{
+    TreeNode *node;
+    int      nextChild;
+};
+
+
+void startWalk(TreeWalk *walk, TreeNode *tree)
+{
+    walk->node = NULL;
+    walk->depth = 0;
+    walk->next = tree;
+    walk->frames = NULL;
+    walk->count = 0;
+    walk->capacity = 0;
+}
+
+
+int walkTree(TreeWalk *walk)
+{
+    struct walkFrame *frame;
+    TreeNode         *child;
+
+    /* a node (or a sibling of one just left) is waiting to be entered */
+    if (walk->next != NULL)
+    {
+        walk->frames = (struct walkFrame*)growStack(walk->frames, walk->count,
+                       &walk->capacity, sizeof(struct walkFrame));
+
+        frame = &walk->frames[walk->count++];
+        frame->node = walk->next;
+        frame->nextChild = 0;
+
+        walk->node = walk->next;
+        walk->depth = walk->count;
+        walk->next = NULL;
+
+        return WALKENTER;
+    }
+
+    if (walk->count == 0)
+        return WALKDONE;
+
+    /* go down into the innermost node's next child list... */
+    frame = &walk->frames[walk->count - 1];
+
+    while (frame->nextChild < MAXCHILDREN)
+    {
+        child = NODE(frame->node->child[frame->nextChild]);
+        ++frame->nextChild;
+
+        if (child != NULL)
+        {
+            walk->next = child;
+            return walkTree(walk);
+        }
+    }
+
+    /* ...or, when there are none left, leave it for its sibling */
+    walk->node = frame->node;
+    walk->depth = walk->count--;
+    walk->next = NODE(frame->node->sibling);
+
+    return WALKLEAVE;
+}
+
+
+void endWalk(TreeWalk *walk)
+{
+    free(walk->frames);
+
+    walk->frames = NULL;
+    walk->count = walk->capacity = 0;
+}
+
+
+void *growStack(void *stack, int count, int *capacity, size_t frameSize)
+{
+    int newCapacity;
+
+    if (count < *capacity)
+        return stack;
+
+    newCapacity = (*capacity == 0) ? 64 : *capacity * 2;
+
+    stack = realloc(stack, newCapacity * frameSize);
+    if (stack == NULL)
+    {
+        fprintf(listing, "*** Out of memory at line %d.\n", lineno);
+        exit(1);
+    }
+
+    *capacity = newCapacity;
+
+    return stack;
+}
+
+
+/*
+ * NAME:     allocPoolPages()
+ * PURPOSE:  Allocates the node and DecInfo pages that the next node will
+ *            go in, if they aren't there already.  Returns FALSE if
+ *            we've run out of memory (or pages).
+ */
+
+static int allocPoolPages(void)
+{
+    int page = numNodes >> NODEPAGEBITS;
+
+    if (page >= MAXNODEPAGES)
+        return FALSE;
+
+    if (nodePages[page] == NULL)
+        nodePages[page] = (TreeNode*)arenaAlloc(NODEPAGESIZE * sizeof(TreeNode));
+    if (decInfoPages[page] == NULL)
+        decInfoPages[page] = (DecInfo*)arenaAlloc(NODEPAGESIZE * sizeof(DecInfo));
+
+    return (nodePages[page] != NULL) && (decInfoPages[page] != NULL);
+}
+
+
 /*
  * NAME:     allocNewNode()
  * PURPOSE:  Creates a new node for AST construction
@@ -310,34 +476,29 @@ TreeNode *newDecNode(DecKind kind)
 static TreeNode *allocNewNode(void)
 {
     TreeNode *t;
-    int      i;
 
 
-    t = (TreeNode*)malloc(sizeof(TreeNode));
-    if (!t)
+    /* index 0 means "no node", and DecInfo entry 0 is the shared one */
+    if (numNodes == 0)
+        numNodes = numDecInfos = 1;
+
+    if (!allocPoolPages())
     {
         fprintf(listing, "*** Out of memory at line %d.\n", lineno);
+        t = NULL;
     }
     else
     {
-        for (i=0; i < MAXCHILDREN; ++i) t->child[i] = NULL;
-        t->sibling = NULL;
+        t = &nodePages[numNodes >> NODEPAGEBITS][numNodes & (NODEPAGESIZE - 1)];
+
+        /*
+         * Arena memory comes zeroed, which leaves the children, sibling
+         *  and declaration 0, the kinds and types ErrorK, DErrorK and
+         *  TypeError, and the value and DecInfo entry all zero.
+         */
+        t->index = numNodes++;
         t->lineno = lineno;
-		t->nodekind = ErrorK;
-		t->kind.dec = DErrorK;
-		t->op = ERROR;
-		t->val = 0;
-		t->name = NULL;
-		t->functionReturnType = TypeError;
-		t->variableDataType = TypeError;
-		t->expressionType = TypeError;
-        
-        t->isParameter = FALSE;   /* is declaration a formal parameter? */
-        t->isGlobal = FALSE;      /* is the variable a global? */
-		t->declaration = NULL;    /* if an identifier, ptr to dec. node */
-       
-        t->localSize = 0;
-        t->offset = 0;            /* if local/parm definition, offset */
+        t->op = ERROR;
     }
 
     return t;
@@ -346,7 +507,7 @@ static TreeNode *allocNewNode(void)
 
 /*
  * NAME:     copyString()
- * PURPOSE:  Allocates space for a new string copied from an existing one.
+ * PURPOSE:  Copies a string into the compilation arena (see Arena.h).
  */
 
 char *copyString(char *source)
@@ -359,7 +520,7 @@ char *copyString(char *source)
         return NULL;
 
     sLength = strlen(source)+1;
-    newString = (char*)malloc(sLength);
+    newString = (char*)arenaAlloc(sLength);
 
     if (!newString)
         fprintf(listing, "*** Out of memory on line %d.\n", lineno);
@@ -370,4 +531,123 @@ char *copyString(char *source)
 }
 
 
+/*
+ * NAME:     loadFileImage()
+ * PURPOSE:  Makes the entire contents of an open file available in memory.
+ *            Returns FALSE if the file could not be read.
+ *
+ *  Regular files are mapped into memory; anything that can't be mapped
+ *   (pipes, terminals, empty files) is read in a single pass instead.
+ */
+
+int loadFileImage(FILE *file, FileImage *image)
+{
+    image->text = NULL;
+    image->length = 0;
+    image->isMapped = FALSE;
+
+    if (mapFileImage(file, image))
+        return TRUE;
+
+    return readFileImage(file, image);
+}
+
+
+/*
+ * NAME:     releaseFileImage()
+ * PURPOSE:  Releases the memory held by a FileImage.
+ */
+
+void releaseFileImage(FileImage *image)
+{
+#ifndef _WIN32
+    if (image->isMapped)
+        munmap(image->text, image->length);
+    else
+#endif
+        free(image->text);
+
+    image->text = NULL;
+    image->length = 0;
+    image->isMapped = FALSE;
+}
+
+
+/*
+ * NAME:     mapFileImage()
+ * PURPOSE:  Maps a regular file into memory.  Returns FALSE if the file
+ *            can't be mapped, in which case the caller should read it.
+ *
+ *  On Windows, source files are opened in text mode and the C library
+ *   strips the carriage returns for us; a mapped view would hand the
+ *   scanner raw CR/LF pairs, so we always read the file there instead.
+ */
+
+static int mapFileImage(FILE *file, FileImage *image)
+{
+#ifdef _WIN32
+    return FALSE;
+#else
+    struct stat info;
+    void        *view;
+
+    if ((fstat(fileno(file), &info) != 0) || (!S_ISREG(info.st_mode))
+            || (info.st_size <= 0))
+        return FALSE;
+
+    view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE,
+                fileno(file), 0);
+    if (view == MAP_FAILED)
+        return FALSE;
+
+    image->text = (char*)view;
+    image->length = (size_t)info.st_size;
+    image->isMapped = TRUE;
+
+    return TRUE;
+#endif
+}
+
+
+/*
+ * NAME:     readFileImage()
+ * PURPOSE:  Reads the remainder of a file into a single growable buffer.
+ */
+
+static int readFileImage(FILE *file, FileImage *image)
+{
+    size_t capacity = 65536;
+    size_t count;
+    char   *newText;
+
+    image->text = (char*)malloc(capacity);
+
+    while (image->text != NULL)
+    {
+        count = fread(image->text + image->length, 1,
+                      capacity - image->length, file);
+        image->length += count;
+
+        if (image->length < capacity)
+            break;
+
+        /* buffer is full: double it and keep reading */
+        capacity *= 2;
+        newText = (char*)realloc(image->text, capacity);
+        if (newText == NULL)
+            free(image->text);
+        image->text = newText;
+    }
+
+    if (image->text == NULL)
+    {
+        fprintf(listing, "*** Out of memory reading source file.\n");
+        image->length = 0;
+        return FALSE;
+    }
+
+    return !ferror(file);
+}
+
+
 /* END OF FILE */
@@ -47,20 +47,157 @@ TreeNode *newExpNode(ExpKind kind);
 
 /*
  * NAME:     newDecNode()
- * PURPOSE:  Creates a new Declaration node for AST construction.
+ * PURPOSE:  Creates a new Declaration node for AST construction, along
+ *            with its DecInfo entry.
  */
 
 TreeNode *newDecNode(DecKind kind);
 
 
+/*
+ * The node pool.  Tree nodes and DecInfo entries are allocated from the
+ *  arena in pages of NODEPAGESIZE, so nodes made one after another sit
+ *  side by side in memory, and a page never moves once it's allocated.
+ *  NODE() and DECINFO() may evaluate their argument more than once.
+ */
+
+#define NODEPAGEBITS  10
+#define NODEPAGESIZE  (1 << NODEPAGEBITS)
+#define MAXNODEPAGES  16384
+
+extern TreeNode *nodePages[MAXNODEPAGES];
+extern DecInfo  *decInfoPages[MAXNODEPAGES];
+
+#define NODE(index) ((index) == 0 ? NULL \
+    : &nodePages[(index) >> NODEPAGEBITS][(index) & (NODEPAGESIZE - 1)])
+
+#define DECINFO(node) (&decInfoPages[(node)->decInfo >> NODEPAGEBITS] \
+    [(node)->decInfo & (NODEPAGESIZE - 1)])
+
+
+/*
+ * NAME:     nodeIndex()
+ * PURPOSE:  Returns the index of a node in the node pool, or 0 for NULL.
+ */
+
+NodeIndex nodeIndex(TreeNode *node);
+
+
+/*
+ * NAME:     resetNodePool()
+ * PURPOSE:  Forgets every node in the pool.  The pages themselves belong
+ *            to the arena, and go with releaseArena().
+ */
+
+void resetNodePool(void);
+
+
+/*
+ * Walking a syntax tree with an explicit stack instead of recursion, so
+ *  that deeply nested programs can't overflow the C stack.  walkTree()
+ *  steps through the tree in the same order as the usual recursive walk:
+ *  each node is entered, then its children's lists are walked in turn,
+ *  then the node is left, then its siblings follow.
+ *
+ *      TreeWalk walk;
+ *      int      step;
+ *
+ *      startWalk(&walk, tree);
+ *      while ((step = walkTree(&walk)) != WALKDONE)
+ *          ... walk.node, walk.depth ...
+ *      endWalk(&walk);
+ */
+
+#define WALKDONE   0
+#define WALKENTER  1
+#define WALKLEAVE  2
+
+typedef struct
+{
+    TreeNode *node;       /* the node just entered or left */
+    int      depth;       /* its depth: nodes in "tree"'s list are 1 deep */
+
+    /* private to walkTree() */
+    TreeNode *next;       /* the next node to enter, if any */
+    struct walkFrame *frames;
+    int      count;
+    int      capacity;
+} TreeWalk;
+
+
+/*
+ * NAME:     startWalk()
+ * PURPOSE:  Sets up a walk over "tree" and its siblings.
+ */
+
+void startWalk(TreeWalk *walk, TreeNode *tree);
+
+
+/*
+ * NAME:     walkTree()
+ * PURPOSE:  Takes the next step of a walk, returning WALKENTER or
+ *            WALKLEAVE with walk->node set, or WALKDONE at the end.
+ */
+
+int walkTree(TreeWalk *walk);
+
+
+/*
+ * NAME:     endWalk()
+ * PURPOSE:  Releases the stack of a walk, finished or not.
+ */
+
+void endWalk(TreeWalk *walk);
+
+
+/*
+ * NAME:     growStack()
+ * PURPOSE:  Makes room for "count"+1 frames of "frameSize" bytes on an
+ *            explicit stack, reallocating it (and updating "capacity") if
+ *            need be.  Returns the stack, which may have moved.
+ */
+
+void *growStack(void *stack, int count, int *capacity, size_t frameSize);
+
+
 /*
  * NAME:     copyString()
- * PURPOSE:  Allocates space for a new string copied from an existing one.
+ * PURPOSE:  Copies a string into the compilation arena (see Arena.h).
  */
 
 char *copyString(char *source);
 
 
+/*
+ * A whole input file held in memory, either mapped straight from the
+ *  file system or read into a malloc()'d buffer in one go.
+ */
+
+typedef struct
+{
+    char   *text;       /* the file's contents (not null-terminated) */
+    size_t length;      /* number of characters in "text" */
+    int    isMapped;    /* TRUE if "text" is a mapped view of the file */
+} FileImage;
+
+
+/*
+ * NAME:     loadFileImage()
+ * PURPOSE:  Makes the entire contents of an open file available in memory.
+ *            Returns FALSE if the file could not be read.
+ */
+
+int loadFileImage(FILE *file, FileImage *image);
+
+
+/*
+ * NAME:     releaseFileImage()
+ * PURPOSE:  Releases the memory held by a FileImage.
+ */
+
+void releaseFileImage(FileImage *image);
+
+
 #endif
 
 /* END OF FILE */